@@ -2,68 +2,97 @@
 
 #include <string>
 #include <vector>
-#include <thread>
 #include <chrono>
 
-struct Pixel {
-    int R;
-    int G;
-    int B;
-};
+#include <ImageBuffer.hpp>
+#include <ImageIO.hpp>
+#include <SummedAreaTable.hpp>
+#include <TileScheduler.hpp>
 
-static std::vector<Pixel>& ImageDataToPixelArray(unsigned char* imageData, int width, int height, int channels);
+#include "ConvolutionEngine.hpp"
 
-static unsigned char* PixelArrayToImageData(const std::vector<Pixel>& pixelArray, int width, int height, int channels);
 class BmpProcessor
 {
     public:
-        BmpProcessor(const std::string& filename);
+        // pool splits decoding and encoding of the BMP rows, nullptr keeps them on the calling thread.
+        // bandRows > 0 only opens the input for ProcessStream instead of loading it.
+        BmpProcessor(const ConvolutionKernel& kernel, ThreadPool* pool = nullptr, int bandRows = 0);
+        BmpProcessor(const std::string& filename, const ConvolutionKernel& kernel, ThreadPool* pool = nullptr, int bandRows = 0);
         ~BmpProcessor() = default;
 
+        // (re)loads the input, the buffers of the previous image are reused when the new one fits
+        bool Load(const std::string& filename);
+
         bool GetIsReady() { return _ready; }
 
+        // per image progress messages on stdout, errors are always printed
+        void SetVerbose(bool verbose) { _verbose = verbose; }
+
+        // convolve into a per-thread 2-row window and downscale it right away,
+        // the full resolution conv image is never allocated
+        void SetFusedMode(bool fused) { _fused = fused; }
+
+        // Output is the input shrunk by `scale` (>= 1, fractional allowed). 2 keeps the legacy 2x minimization,
+        // any other factor averages the source box of every output pixel through a summed-area table.
+        void SetScale(double scale) { _scale = scale; }
+
+        // every 1/2, 1/4, 1/8 ... level from one summed-area table per channel,
+        // SaveFile writes level 1/f next to the given name as {name}_f.bmp
+        void SetPyramidMode(bool pyramid) { _pyramid = pyramid; }
+
         void ProcessImageMultithread(int threadCount = 1);
 
         void ProcessImageSingleThread();
 
-        void SaveFile(const std::string& filename);
+        bool SaveFile(const std::string& filename);
+
+        // Reads the input bandRows output rows at a time (plus the rows the kernel reaches),
+        // runs the fused path on the band and writes it to outputFilename.
+        // Memory is bounded by the band size instead of the image size.
+        bool ProcessStream(const std::string& outputFilename, int threadCount = 1);
 
     private:
-        void ProcessImage(int startLine, int endLine);
-        void PerformIntencityStep(int x, int y);
-        void PerformMinimizationStep(int x, int y);
+        void PrepareOutput();
+        bool UsesAreaPath() const { return _pyramid || _scale != 2.0; }
+        void ProcessArea(ThreadPool* pool);
+
+        void SchedulePhases(TileScheduler& scheduler);
+        void ConvolveTile(const TileRect& tile);
+        void MinimizeTile(const TileRect& tile);
+        void ProcessFusedTile(const TileRect& tile);
+        void MinimizeRow(int minimY, int startX, int endX, const ImageBuffer& convRows, int firstConvRow);
 
     private:
         bool _ready = false;
-        // threading and time
-        std::vector<std::thread> _threads;
+        bool _verbose = true;
+        ThreadPool* _pool = nullptr;
+        // time
         std::chrono::steady_clock::time_point _tsBegin;
         std::chrono::steady_clock::time_point _tsEnd;
 
         // conv stuff
-        int _convCore[3][3] = {
-            /* relief matrix */
-            {-2, -1, 0},
-            {-1,  1, 1},
-            { 0,  1, 2}
-            /* edge detection */
-            // {0,  1, 0},
-            // {1, -4, 1},
-            // {0,  1, 0}
-            /* nothing kekw */
-            // {0, 0, 0},
-            // {0, 1, 0},
-            // {0, 0, 0}
-        };
-        int _kernelHeight = 3;
-        int _kernelWidth = 3;
+        ConvolutionEngine _convEngine;
+        bool _fused = false;
         
         // image processing
         int _width, _height, _channels;
-        int _minimizationScale = 2;
         int _minimizedWidth, _minimizedHeight;
 
-        std::vector<Pixel> _initialPixelArray;
-        std::vector<Pixel> _convPixelArray;
-        std::vector<Pixel> _resultPixelArray;
-};
\ No newline at end of file
+        // streaming reads one band into _initialImage and fills _resultImage one band at a time,
+        // the first image row each of them holds (0 when the whole image is loaded)
+        int _bandRows = 0;
+        int _inputFirstRow = 0;
+        int _resultFirstRow = 0;
+        BmpBandReader _reader;
+
+        // area downscale
+        double _scale = 2.0;
+        bool _pyramid = false;
+        SummedAreaTable _table;
+        // level i is the image shrunk by 2^(i + 1)
+        std::vector<ImageBuffer> _pyramidLevels;
+
+        ImageBuffer _initialImage;
+        ImageBuffer _convImage;
+        ImageBuffer _resultImage;
+};
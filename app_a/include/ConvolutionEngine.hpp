@@ -0,0 +1,53 @@
+#pragma once
+
+#include <ImageBuffer.hpp>
+#include <ImageKernels.hpp>
+
+#include "ConvolutionKernel.hpp"
+
+// Applies a ConvolutionKernel to every plane of an ImageBuffer.
+// Interior pixels go through the image_core SIMD kernels when the weights fit the 16-bit accumulator,
+// otherwise through fully unrolled 3x3, 5x5, 7x7 instantiations or a generic loop.
+// Only the border pixels are bounds checked.
+class ConvolutionEngine
+{
+    public:
+        ConvolutionEngine() = default;
+        explicit ConvolutionEngine(const ConvolutionKernel& kernel);
+
+        const ConvolutionKernel& GetKernel() const { return _kernel; }
+        // human readable name of the interior path
+        const char* GetPathName() const { return _pathName; }
+
+        // convolves rows [startLine, endLine) of every plane of src into the same rows of dst
+        void ConvolveRows(const ImageBuffer& src, ImageBuffer& dst, int startLine, int endLine) const;
+
+        // convolves row y of one plane of src into dstRow (src width pixels)
+        void ConvolveRow(const ImageBuffer& src, int channel, int y, uint8_t* dstRow) const;
+
+        // same for pixels [startX, endX) of the row only, dstRow is still indexed by x
+        void ConvolveRowSpan(const ImageBuffer& src, int channel, int y, uint8_t* dstRow, int startX, int endX) const;
+
+        // src is a band holding image rows [srcFirstRow, srcFirstRow + src height) of an image imageHeight rows high,
+        // y is an image row; the band has to cover the kernel rows around y that lie inside the image
+        void ConvolveBandRowSpan(const ImageBuffer& src, int srcFirstRow, int imageHeight, int channel, int y,
+                                 uint8_t* dstRow, int startX, int endX) const;
+
+    private:
+        using InteriorRowFunction = void (*)(const int* weights, int kernelWidth, int kernelHeight, int weightSum,
+                                             const uint8_t* src, size_t stride, int y, uint8_t* dstRow, int startX, int endX);
+
+        // built on use, the weights pointer must not outlive this engine (or a copy of it)
+        ConvolutionTaps GetTaps() const { return { _kernel.Width, _kernel.Height, _kernel.Weights.data(), _weightSum }; }
+        uint8_t ConvolveBorderPixel(const ImageBuffer& src, int srcFirstRow, int imageHeight, int channel, int x, int y) const;
+
+    private:
+        ConvolutionKernel _kernel;
+        int _weightSum = 1;
+        // kernel reach around the anchor pixel
+        int _left = 0, _right = 0, _top = 0, _bottom = 0;
+
+        InteriorRowFunction _interiorRow = nullptr;
+        ConvolveRowFunction _simdRow = nullptr;
+        const char* _pathName = "None";
+};
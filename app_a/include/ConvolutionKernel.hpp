@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Integer convolution kernel, weights stored row by row
+struct ConvolutionKernel {
+    std::string Name = "None";
+    int Width = 0;
+    int Height = 0;
+    std::vector<int> Weights;
+
+    int At(int x, int y) const { return Weights[y * Width + x]; }
+
+    // divisor used for pixels where the whole kernel fits into the image
+    int WeightSum() const
+    {
+        int sum = 0;
+        for (int weight : Weights) sum += weight;
+        return sum == 0 ? 1 : sum;
+    }
+};
+
+// "relief", "edge", "identity", "sharpen", "box3", "gaussian5", "box7"
+bool GetBuiltinKernel(const std::string& name, ConvolutionKernel& kernel);
+
+// Text file, one kernel row per line, weights separated by spaces or commas, '#' starts a comment
+bool LoadKernelFromFile(const std::string& filename, ConvolutionKernel& kernel);
+
+// Builtin kernel name or path to a kernel file
+bool ResolveKernel(const std::string& nameOrFilename, ConvolutionKernel& kernel);
+
+std::vector<std::string> GetBuiltinKernelNames();
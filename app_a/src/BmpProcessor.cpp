@@ -1,201 +1,305 @@
 #include "BmpProcessor.hpp"
 
+#include <algorithm>
 #include <iostream>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include <ImageIO.hpp>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
-
-static std::vector<Pixel>& ImageDataToPixelArray(unsigned char* imageData, int width, int height, int channels)
+BmpProcessor::BmpProcessor(const ConvolutionKernel& kernel, ThreadPool* pool, int bandRows) :
+    _pool(pool),
+    _convEngine(kernel),
+    _bandRows(bandRows)
 {
-    std::vector<Pixel>* pixelArray = new std::vector<Pixel>();
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Pixel px {
-                .R = imageData[y * width * channels + x * channels],    
-                .G = imageData[y * width * channels + x * channels + 1],
-                .B = imageData[y * width * channels + x * channels + 2],
-            };
-            pixelArray->push_back(px);
-        }
-    }
+}
 
-    return *pixelArray;
+BmpProcessor::BmpProcessor(const std::string& filename, const ConvolutionKernel& kernel, ThreadPool* pool, int bandRows) :
+    BmpProcessor(kernel, pool, bandRows)
+{
+    Load(filename);
 }
 
-static unsigned char* PixelArrayToImageData(const std::vector<Pixel>& pixelArray, int width, int height, int channels)
+bool BmpProcessor::Load(const std::string& filename)
 {
-    unsigned char* imageData = (unsigned char *) malloc(height * width * channels);
+    _ready = false;
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            imageData[y * width * channels + x * channels] = pixelArray[y * width + x].R;
-            imageData[y * width * channels + x * channels + 1] = pixelArray[y * width + x].G;
-            imageData[y * width * channels + x * channels + 2] = pixelArray[y * width + x].B;
-        }
+    if (_bandRows > 0)
+    {
+        if (!_reader.Open(filename)) return false;
+
+        _width = _reader.GetWidth();
+        _height = _reader.GetHeight();
+        _channels = _reader.GetSourceChannels();
+    }
+    else
+    {
+        if (!LoadImage(filename, _initialImage, 3, &_channels, _pool)) return false;
+
+        _width = _initialImage.GetWidth();
+        _height = _initialImage.GetHeight();
+    }
+    
+    if (_verbose)
+    {
+        const ConvolutionKernel& kernel = _convEngine.GetKernel();
+        std::cout << "Image: " << filename << "; Width: " << _width << "; Height: " << _height << "; Number of channels: " << _channels << "\n";
+        std::cout << "Kernel: " << kernel.Name << " (" << kernel.Width << "x" << kernel.Height << "), path: " << _convEngine.GetPathName() << "\n";
     }
 
-    return imageData;
+    _minimizedWidth = _width / 2;
+    _minimizedHeight = _height / 2;
+
+    _ready = true;
+    return true;
 }
 
-BmpProcessor::BmpProcessor(const std::string& filename)
+void BmpProcessor::PrepareOutput()
 {
-    unsigned char* imageData = stbi_load(filename.c_str(), &_width, &_height, &_channels, 3);
-
-    if (!imageData)
+    if (_pyramid)
     {
-        std::cout << "Failed to load image";
+        size_t levelCount = 0;
+        for (int factor = 2; _width / factor > 0 && _height / factor > 0 &&
+             (uint64_t)factor * factor <= SummedAreaTable::MaxBoxArea; factor *= 2)
+        {
+            levelCount++;
+        }
+
+        _pyramidLevels.resize(levelCount);
+        for (size_t level = 0; level < levelCount; level++)
+        {
+            int factor = 2 << level;
+            _pyramidLevels[level].Resize(_width / factor, _height / factor, 3);
+        }
         return;
     }
-    
-    std::cout << "Image: " << filename << "; Width: " << _width << "; Height: " << _height << "; Number of channels: " << _channels << "\n";
-    
-    _initialPixelArray = ImageDataToPixelArray(imageData, _width, _height, _channels);
-
-    _convPixelArray.resize(_height * _width);
 
-    _minimizedWidth = _width / 2;
-    _minimizedHeight = _height / 2;
-    
-    _resultPixelArray.resize(_minimizedHeight * _minimizedWidth);
+    _minimizedWidth = (int)(_width / _scale);
+    _minimizedHeight = (int)(_height / _scale);
+    _resultImage.Resize(_minimizedWidth, _minimizedHeight, 3);
+}
 
-    stbi_image_free(imageData);
+void BmpProcessor::ProcessArea(ThreadPool* pool)
+{
+    // one channel at a time keeps a single table alive, conv rows go straight into it
+    for (int c = 0; c < 3; c++)
+    {
+        _table.Build(_width, _height, [this, c](int y, uint8_t* row) {
+            _convEngine.ConvolveRowSpan(_initialImage, c, y, row, 0, _width);
+        }, pool);
 
-    _ready = true;
+        if (_pyramid)
+        {
+            for (size_t level = 0; level < _pyramidLevels.size(); level++)
+            {
+                double factor = (double)(2 << level);
+                DownscaleArea(_table, factor, factor, _pyramidLevels[level], c, pool);
+            }
+        }
+        else
+        {
+            DownscaleArea(_table, _scale, _scale, _resultImage, c, pool);
+        }
+    }
 }
 
 void BmpProcessor::ProcessImageMultithread(int threadCount)
 {
-    std::cout << "Started processing with " << threadCount << " thread(s)" << std::endl;
+    if (_verbose) std::cout << "Started processing with " << threadCount << " thread(s)" << std::endl;
     _tsBegin = std::chrono::steady_clock::now();
 
-    int step = _height / threadCount;
-    for (int i = 0; i < threadCount; i++)
+    PrepareOutput();
+    if (UsesAreaPath())
     {
-        int start = i * step;
-        int end = (i + 1) * step + 1;
-        _threads.push_back(std::thread(&BmpProcessor::ProcessImage, this, start, end));
+        ProcessArea(&ThreadPool::Shared(threadCount));
     }
-
-    for (auto& thread : _threads)
+    else
     {
-        if (thread.joinable()) thread.join();
+        TileScheduler scheduler;
+        SchedulePhases(scheduler);
+        scheduler.Run(ThreadPool::Shared(threadCount));
     }
 
     _tsEnd = std::chrono::steady_clock::now();
 
-    std::cout << "Ended processing. TIme elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(_tsEnd - _tsBegin).count() << " ms" << std::endl;
+    if (_verbose) std::cout << "Ended processing. TIme elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(_tsEnd - _tsBegin).count() << " ms" << std::endl;
 }
 
-void BmpProcessor::ProcessImage(int startLine, int endLine)
+bool BmpProcessor::ProcessStream(const std::string& outputFilename, int threadCount)
 {
-    for (int y = startLine; y < endLine && y < _height; y++) 
+    std::cout << "Started streaming with " << threadCount << " thread(s), " << _bandRows << " row(s) per band" << std::endl;
+    _tsBegin = std::chrono::steady_clock::now();
+
+    ThreadPool& pool = ThreadPool::Shared(threadCount);
+    BmpBandWriter writer;
+    if (!writer.Open(outputFilename, _minimizedWidth, _minimizedHeight)) return false;
+
+    const ConvolutionKernel& kernel = _convEngine.GetKernel();
+    int top = kernel.Height / 2;
+    int bottom = kernel.Height - 1 - top;
+
+    for (int firstRow = 0; firstRow < _minimizedHeight; firstRow += _bandRows)
     {
-        for (int x = 0; x < _width; x++) 
+        int endRow = std::min(firstRow + _bandRows, _minimizedHeight);
+
+        // conv rows 2 * firstRow - 1 .. 2 * endRow - 1 and the kernel reach around them
+        int inputBegin = std::max(firstRow * 2 - 1 - top, 0);
+        int inputEnd = std::min(endRow * 2 + bottom, _height);
+        if (!_reader.ReadRows(inputBegin, inputEnd - inputBegin, _initialImage, 3, &pool))
         {
-            PerformIntencityStep(x, y);
+            std::cout << "Failed to read rows " << inputBegin << ".." << inputEnd << "\n";
+            return false;
         }
+
+        _inputFirstRow = inputBegin;
+        _resultFirstRow = firstRow;
+        _resultImage.Resize(_minimizedWidth, endRow - firstRow, 3);
+
+        TileScheduler scheduler;
+        scheduler.AddPhase(_minimizedWidth, endRow - firstRow, [this](const TileRect& tile) { ProcessFusedTile(tile); });
+        scheduler.Run(pool);
+
+        if (!writer.WriteRows(firstRow, _resultImage, &pool)) break;
     }
 
-    for (int y = startLine; y < endLine && y < _height; y += _minimizationScale) 
+    bool written = writer.Close();
+    if (!written) std::cerr << "Couldn't write file: " << outputFilename << "\n";
+
+    _tsEnd = std::chrono::steady_clock::now();
+
+    std::cout << "Ended processing. TIme elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(_tsEnd - _tsBegin).count() << " ms" << std::endl;
+    return written;
+}
+
+void BmpProcessor::ProcessImageSingleThread()
+{
+    PrepareOutput();
+    if (UsesAreaPath())
     {
-        for (int x = 0; x < _width; x += _minimizationScale) 
-        {
-            PerformMinimizationStep(x, y);
-        }
+        ProcessArea(nullptr);
+        return;
     }
+
+    TileScheduler scheduler;
+    SchedulePhases(scheduler);
+    scheduler.RunSequential();
 }
 
-void BmpProcessor::ProcessImageSingleThread()
+void BmpProcessor::SchedulePhases(TileScheduler& scheduler)
 {
-    ProcessImage(0, _height);
-    
+    if (_fused)
+    {
+        scheduler.AddPhase(_minimizedWidth, _minimizedHeight, [this](const TileRect& tile) { ProcessFusedTile(tile); });
+        return;
+    }
+
+    _convImage.Resize(_width, _height, 3);
+
+    scheduler.AddPhase(_width, _height, [this](const TileRect& tile) { ConvolveTile(tile); });
+    // minimized pixel (x, y) reads the conv 2x2 block ending at (2x, 2y)
+    scheduler.AddPhase(_minimizedWidth, _minimizedHeight, [this](const TileRect& tile) { MinimizeTile(tile); },
+        [](const TileRect& tile) { return TileRect{ tile.X0 * 2 - 1, tile.Y0 * 2 - 1, tile.X1 * 2, tile.Y1 * 2 }; });
 }
 
-void BmpProcessor::PerformIntencityStep(int x, int y)
+void BmpProcessor::ConvolveTile(const TileRect& tile)
 {
-    int rSum = 0, gSum = 0, bSum = 0, weightSum = 0;
-    for (int convY = 0; convY < _kernelHeight; convY++)
+    for (int y = tile.Y0; y < tile.Y1; y++)
     {
-        for (int convX = 0; convX < _kernelWidth; convX++)
+        for (int c = 0; c < 3; c++)
         {
-            int pixelX = x + (convX - (_kernelWidth / 2));
-            int pixelY = y + (convY - (_kernelHeight / 2));
-            
-            if (pixelX < 0 || pixelX >= _width || pixelY < 0 || pixelY >= _height) continue;
-
-            rSum += _initialPixelArray[pixelY * _width + pixelX].R * _convCore[convY][convX];
-            gSum += _initialPixelArray[pixelY * _width + pixelX].G * _convCore[convY][convX];
-            bSum += _initialPixelArray[pixelY * _width + pixelX].B * _convCore[convY][convX];
-            weightSum += _convCore[convY][convX];
+            _convEngine.ConvolveRowSpan(_initialImage, c, y, _convImage.Row(c, y), tile.X0, tile.X1);
         }
     }
+}
 
-    if (weightSum == 0) weightSum = 1;
+void BmpProcessor::MinimizeTile(const TileRect& tile)
+{
+    for (int minimY = tile.Y0; minimY < tile.Y1; minimY++)
+    {
+        MinimizeRow(minimY, tile.X0, tile.X1, _convImage, 0);
+    }
+}
 
-    rSum /= weightSum;
-    if (rSum < 0) rSum = 0;
-    if (rSum > 255) rSum = 255;
+void BmpProcessor::ProcessFusedTile(const TileRect& tile)
+{
+    // conv rows y - 1 and y of the current minimized row, rows of different minimized rows never overlap
+    static thread_local ImageBuffer convRows;
+    convRows.Resize(_width, 2, 3);
 
-    gSum /= weightSum;
-    if (gSum < 0) gSum = 0;
-    if (gSum > 255) gSum = 255;
+    int startX = std::max(tile.X0 * 2 - 1, 0);
+    int endX = tile.X1 * 2;
 
-    bSum /= weightSum;
-    if (bSum < 0) bSum = 0;
-    if (bSum > 255) bSum = 255;
-    
-    _convPixelArray[y * _width + x].R = rSum;
-    _convPixelArray[y * _width + x].G = gSum;
-    _convPixelArray[y * _width + x].B = bSum;
-}
+    // tiles are numbered from the first row of _resultImage
+    for (int minimY = tile.Y0 + _resultFirstRow; minimY < tile.Y1 + _resultFirstRow; minimY++)
+    {
+        int y = minimY * 2;
+        for (int c = 0; c < 3; c++)
+        {
+            if (y > 0) _convEngine.ConvolveBandRowSpan(_initialImage, _inputFirstRow, _height, c, y - 1, convRows.Row(c, 0), startX, endX);
+            _convEngine.ConvolveBandRowSpan(_initialImage, _inputFirstRow, _height, c, y, convRows.Row(c, 1), startX, endX);
+        }
 
+        MinimizeRow(minimY, tile.X0, tile.X1, convRows, y - 1);
+    }
+}
 
-void BmpProcessor::PerformMinimizationStep(int x, int y)
+void BmpProcessor::MinimizeRow(int minimY, int startX, int endX, const ImageBuffer& convRows, int firstConvRow)
 {
-    int rSum = 0, gSum = 0, bSum = 0, weightSum = 0;
-    for (int minimY = 0; minimY < _minimizationScale; minimY++)
+    // output pixel (x / 2, y / 2) averages the 2x2 block ending at (x, y), cut by the top and left borders
+    const ImageKernels& kernels = GetImageKernels();
+    int y = minimY * 2;
+
+    // convRows holds conv rows starting from firstConvRow
+    for (int c = 0; c < convRows.GetChannels(); c++)
     {
-        for (int minimX = 0; minimX < _minimizationScale; minimX++)
+        const uint8_t* rowB = convRows.Row(c, y - firstConvRow);
+        uint8_t* dst = _resultImage.Row(c, minimY - _resultFirstRow);
+
+        if (y == 0)
         {
-            int pixelX = x + (minimX - _minimizationScale / 2);
-            int pixelY = y + (minimY - _minimizationScale / 2);
-            
-            if (pixelX < 0 || pixelX >= _width || pixelY < 0 || pixelY >= _height) continue;
+            for (int minimX = startX; minimX < endX; minimX++)
+            {
+                dst[minimX] = minimX == 0 ? rowB[0] : (rowB[minimX * 2 - 1] + rowB[minimX * 2]) / 2;
+            }
+            continue;
+        }
 
-            rSum += _convPixelArray[pixelY * _width + pixelX].R;
-            gSum += _convPixelArray[pixelY * _width + pixelX].G;
-            bSum += _convPixelArray[pixelY * _width + pixelX].B;
+        const uint8_t* rowA = convRows.Row(c, y - 1 - firstConvRow);
+        int minimX = startX;
+        if (minimX == 0)
+        {
+            dst[0] = (rowA[0] + rowB[0]) / 2;
+            minimX++;
+        }
 
-            weightSum += 1;
+        if (minimX < endX)
+        {
+            kernels.Downscale2xRow(rowA + minimX * 2 - 1, rowB + minimX * 2 - 1, dst + minimX, endX - minimX);
         }
     }
+}
 
-    rSum /= weightSum;
-    if (rSum < 0) rSum = 0;
-    if (rSum > 255) rSum = 255;
-
-    gSum /= weightSum;
-    if (gSum < 0) gSum = 0;
-    if (gSum > 255) gSum = 255;
+// {name}_{factor}{extension}, the extension is kept from filename
+static std::string PyramidLevelPath(const std::string& filename, int factor)
+{
+    size_t dot = filename.find_last_of('.');
+    size_t separator = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) dot = filename.size();
 
-    bSum /= weightSum;
-    if (bSum < 0) bSum = 0;
-    if (bSum > 255) bSum = 255;
-    
-    int minimY = y / _minimizationScale;
-    int minimX = x / _minimizationScale;
-    _resultPixelArray[minimY * _minimizedWidth + minimX].R = rSum;
-    _resultPixelArray[minimY * _minimizedWidth + minimX].G = gSum;
-    _resultPixelArray[minimY * _minimizedWidth + minimX].B = bSum;
+    return filename.substr(0, dot) + "_" + std::to_string(factor) + filename.substr(dot);
 }
 
-void BmpProcessor::SaveFile(const std::string& filename)
+bool BmpProcessor::SaveFile(const std::string& filename)
 {
-    unsigned char* imageData = PixelArrayToImageData(_resultPixelArray, _minimizedWidth, _minimizedHeight, _channels);
+    if (!_pyramid) return SaveBmp(filename, _resultImage, _pool);
+    if (_pyramidLevels.empty())
+    {
+        std::cerr << "No pyramid level to save, the image is smaller than 2x2: " << filename << "\n";
+        return false;
+    }
 
-    stbi_write_bmp((filename).c_str(), _minimizedWidth, _minimizedHeight, 3, (const void*)imageData);
+    bool saved = true;
+    for (size_t level = 0; level < _pyramidLevels.size(); level++)
+    {
+        saved = SaveBmp(PyramidLevelPath(filename, 2 << level), _pyramidLevels[level], _pool) && saved;
+    }
+    return saved;
 }
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "ConvolutionEngine.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+static inline uint8_t ClampChannel(int value)
+{
+    if (value < 0) return 0;
+    if (value > 255) return 255;
+    return (uint8_t)value;
+}
+
+// One expression per tap, so the compiler sees straight-line code with constant offsets
+template <int KW, int KH, int... Taps>
+static inline int AccumulateTaps(const int* weights, const uint8_t* anchor, ptrdiff_t stride,
+                                 std::integer_sequence<int, Taps...>)
+{
+    return ((anchor[(Taps / KW - KH / 2) * stride + (Taps % KW - KW / 2)] * weights[Taps]) + ...);
+}
+
+template <int KW, int KH, bool Normalize>
+static void ConvolveInteriorRowFixed(const int* weights, int, int, int weightSum,
+                                     const uint8_t* src, size_t stride, int y, uint8_t* dstRow, int startX, int endX)
+{
+    int localWeights[KW * KH];
+    std::copy(weights, weights + KW * KH, localWeights);
+
+    const uint8_t* srcRow = src + y * stride;
+
+    for (int x = startX; x < endX; x++)
+    {
+        int sum = AccumulateTaps<KW, KH>(localWeights, srcRow + x, (ptrdiff_t)stride,
+                                         std::make_integer_sequence<int, KW * KH>{});
+        if (Normalize) sum /= weightSum;
+        dstRow[x] = ClampChannel(sum);
+    }
+}
+
+static void ConvolveInteriorRowGeneric(const int* weights, int kernelWidth, int kernelHeight, int weightSum,
+                                       const uint8_t* src, size_t stride, int y, uint8_t* dstRow, int startX, int endX)
+{
+    for (int x = startX; x < endX; x++)
+    {
+        int sum = 0;
+        for (int convY = 0; convY < kernelHeight; convY++)
+        {
+            const uint8_t* srcRow = src + (y + convY - kernelHeight / 2) * stride + x - kernelWidth / 2;
+            const int* weightRow = weights + convY * kernelWidth;
+            for (int convX = 0; convX < kernelWidth; convX++)
+            {
+                sum += srcRow[convX] * weightRow[convX];
+            }
+        }
+        dstRow[x] = ClampChannel(sum / weightSum);
+    }
+}
+
+using RowFunction = void (*)(const int*, int, int, int, const uint8_t*, size_t, int, uint8_t*, int, int);
+
+template <int KW, int KH>
+static bool SelectFixed(int kernelWidth, int kernelHeight, int weightSum, RowFunction& function)
+{
+    if (kernelWidth != KW || kernelHeight != KH) return false;
+
+    if (weightSum == 1) function = &ConvolveInteriorRowFixed<KW, KH, false>;
+    else function = &ConvolveInteriorRowFixed<KW, KH, true>;
+    return true;
+}
+
+ConvolutionEngine::ConvolutionEngine(const ConvolutionKernel& kernel) :
+    _kernel(kernel),
+    _weightSum(kernel.WeightSum()),
+    _left(kernel.Width / 2),
+    _right(kernel.Width - 1 - kernel.Width / 2),
+    _top(kernel.Height / 2),
+    _bottom(kernel.Height - 1 - kernel.Height / 2)
+{
+    const ImageKernels& kernels = GetImageKernels();
+    if (kernels.Level != SimdLevel::Scalar && FitsInt16Accumulator(GetTaps()))
+    {
+        _simdRow = kernels.ConvolveRow;
+        _pathName = SimdLevelName(kernels.Level);
+    }
+    else if (SelectFixed<3, 3>(kernel.Width, kernel.Height, _weightSum, _interiorRow) ||
+             SelectFixed<5, 5>(kernel.Width, kernel.Height, _weightSum, _interiorRow) ||
+             SelectFixed<7, 7>(kernel.Width, kernel.Height, _weightSum, _interiorRow))
+    {
+        _pathName = "unrolled";
+    }
+    else
+    {
+        _interiorRow = &ConvolveInteriorRowGeneric;
+        _pathName = "generic";
+    }
+}
+
+void ConvolutionEngine::ConvolveRows(const ImageBuffer& src, ImageBuffer& dst, int startLine, int endLine) const
+{
+    endLine = std::min(endLine, src.GetHeight());
+
+    for (int y = startLine; y < endLine; y++)
+    {
+        for (int c = 0; c < src.GetChannels(); c++)
+        {
+            ConvolveRow(src, c, y, dst.Row(c, y));
+        }
+    }
+}
+
+void ConvolutionEngine::ConvolveRow(const ImageBuffer& src, int channel, int y, uint8_t* dstRow) const
+{
+    ConvolveRowSpan(src, channel, y, dstRow, 0, src.GetWidth());
+}
+
+void ConvolutionEngine::ConvolveRowSpan(const ImageBuffer& src, int channel, int y, uint8_t* dstRow, int startX, int endX) const
+{
+    ConvolveBandRowSpan(src, 0, src.GetHeight(), channel, y, dstRow, startX, endX);
+}
+
+void ConvolutionEngine::ConvolveBandRowSpan(const ImageBuffer& src, int srcFirstRow, int imageHeight, int channel, int y,
+                                            uint8_t* dstRow, int startX, int endX) const
+{
+    int width = src.GetWidth();
+
+    if (y < _top || y >= imageHeight - _bottom || width <= _left + _right)
+    {
+        for (int x = startX; x < endX; x++) dstRow[x] = ConvolveBorderPixel(src, srcFirstRow, imageHeight, channel, x, y);
+        return;
+    }
+
+    int interiorStart = std::max(startX, _left);
+    int interiorEnd = std::min(endX, width - _right);
+
+    for (int x = startX; x < std::min(endX, interiorStart); x++) dstRow[x] = ConvolveBorderPixel(src, srcFirstRow, imageHeight, channel, x, y);
+
+    if (interiorStart < interiorEnd)
+    {
+        if (_simdRow)
+        {
+            _simdRow(GetTaps(), src.Plane(channel), src.GetStride(), y - srcFirstRow, dstRow, interiorStart, interiorEnd);
+        }
+        else
+        {
+            _interiorRow(_kernel.Weights.data(), _kernel.Width, _kernel.Height, _weightSum,
+                         src.Plane(channel), src.GetStride(), y - srcFirstRow, dstRow, interiorStart, interiorEnd);
+        }
+    }
+
+    for (int x = std::max(startX, interiorEnd); x < endX; x++) dstRow[x] = ConvolveBorderPixel(src, srcFirstRow, imageHeight, channel, x, y);
+}
+
+uint8_t ConvolutionEngine::ConvolveBorderPixel(const ImageBuffer& src, int srcFirstRow, int imageHeight, int channel, int x, int y) const
+{
+    int sum = 0, weightSum = 0;
+    for (int convY = 0; convY < _kernel.Height; convY++)
+    {
+        for (int convX = 0; convX < _kernel.Width; convX++)
+        {
+            int pixelX = x + (convX - _left);
+            int pixelY = y + (convY - _top);
+
+            if (pixelX < 0 || pixelX >= src.GetWidth() || pixelY < 0 || pixelY >= imageHeight) continue;
+
+            int weight = _kernel.At(convX, convY);
+            sum += src.Row(channel, pixelY - srcFirstRow)[pixelX] * weight;
+            weightSum += weight;
+        }
+    }
+
+    if (weightSum == 0) weightSum = 1;
+
+    return ClampChannel(sum / weightSum);
+}
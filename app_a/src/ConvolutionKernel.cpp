@@ -0,0 +1,124 @@
+#include "ConvolutionKernel.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <map>
+
+static const std::map<std::string, ConvolutionKernel>& BuiltinKernels()
+{
+    static const std::map<std::string, ConvolutionKernel> kernels = {
+        { "relief", { "relief", 3, 3, {
+            -2, -1, 0,
+            -1,  1, 1,
+             0,  1, 2 } } },
+        { "edge", { "edge", 3, 3, {
+            0,  1, 0,
+            1, -4, 1,
+            0,  1, 0 } } },
+        { "identity", { "identity", 3, 3, {
+            0, 0, 0,
+            0, 1, 0,
+            0, 0, 0 } } },
+        { "sharpen", { "sharpen", 3, 3, {
+             0, -1,  0,
+            -1,  5, -1,
+             0, -1,  0 } } },
+        { "box3", { "box3", 3, 3, {
+            1, 1, 1,
+            1, 1, 1,
+            1, 1, 1 } } },
+        { "gaussian5", { "gaussian5", 5, 5, {
+            1,  4,  6,  4, 1,
+            4, 16, 24, 16, 4,
+            6, 24, 36, 24, 6,
+            4, 16, 24, 16, 4,
+            1,  4,  6,  4, 1 } } },
+        { "box7", { "box7", 7, 7, std::vector<int>(49, 1) } },
+    };
+    return kernels;
+}
+
+bool GetBuiltinKernel(const std::string& name, ConvolutionKernel& kernel)
+{
+    auto it = BuiltinKernels().find(name);
+    if (it == BuiltinKernels().end()) return false;
+
+    kernel = it->second;
+    return true;
+}
+
+std::vector<std::string> GetBuiltinKernelNames()
+{
+    std::vector<std::string> names;
+    for (auto& entry : BuiltinKernels()) names.push_back(entry.first);
+    return names;
+}
+
+bool LoadKernelFromFile(const std::string& filename, ConvolutionKernel& kernel)
+{
+    std::ifstream input{filename};
+
+    if (!input.is_open())
+    {
+        std::cerr << "Couldn't read kernel file: " << filename << "\n";
+        return false;
+    }
+
+    ConvolutionKernel loaded;
+    loaded.Name = filename;
+
+    for (std::string line; std::getline(input, line);)
+    {
+        line = line.substr(0, line.find('#'));
+        for (char& c : line)
+        {
+            if (c == ',' || c == ';') c = ' ';
+        }
+
+        std::istringstream stream(line);
+        std::vector<int> row;
+        for (std::string token; stream >> token;)
+        {
+            try
+            {
+                size_t parsed = 0;
+                row.push_back(std::stoi(token, &parsed));
+                if (parsed != token.size()) throw std::invalid_argument(token);
+            }
+            catch (const std::exception&)
+            {
+                std::cerr << "Kernel file " << filename << ": bad weight '" << token << "'\n";
+                return false;
+            }
+        }
+
+        if (row.empty()) continue;
+
+        if (loaded.Width != 0 && (int)row.size() != loaded.Width)
+        {
+            std::cerr << "Kernel file " << filename << ": all rows must have " << loaded.Width << " weights\n";
+            return false;
+        }
+
+        loaded.Width = row.size();
+        loaded.Height++;
+        loaded.Weights.insert(loaded.Weights.end(), row.begin(), row.end());
+    }
+
+    if (loaded.Weights.empty())
+    {
+        std::cerr << "Kernel file " << filename << " is empty\n";
+        return false;
+    }
+
+    kernel = loaded;
+    return true;
+}
+
+bool ResolveKernel(const std::string& nameOrFilename, ConvolutionKernel& kernel)
+{
+    if (GetBuiltinKernel(nameOrFilename, kernel)) return true;
+
+    return LoadKernelFromFile(nameOrFilename, kernel);
+}
@@ -1,16 +1,73 @@
 #include <iostream>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <ImageBatch.hpp>
 
 #include "BmpProcessor.hpp"
 
+char* GetOption(char ** begin, char ** end, const std::string & option)
+{
+    char ** itr = std::find(begin, end, option);
+    if (itr != end && ++itr != end)
+    {
+        return *itr;
+    }
+    return 0;
+}
+
+bool OptionExists(char** begin, char** end, const std::string& option)
+{
+    return std::find(begin, end, option) != end;
+}
+
+// output options shared by single file and batch runs
+struct OutputOptions {
+    bool Fused = false;
+    double Scale = 2.0;
+    bool Pyramid = false;
+
+    void Apply(BmpProcessor& processor) const
+    {
+        processor.SetFusedMode(Fused);
+        processor.SetScale(Scale);
+        processor.SetPyramidMode(Pyramid);
+    }
+};
+
+// every image of inputSource is convolved and minimized with the same options into outputDirectory
+int RunBatch(const std::string& inputSource, const std::string& outputDirectory, int numThreads, const ConvolutionKernel& kernel, const OutputOptions& options)
+{
+    std::vector<std::unique_ptr<BmpProcessor>> processors;
+    for (int slot = 0; slot < BatchSlotCount; slot++)
+    {
+        processors.push_back(std::make_unique<BmpProcessor>(kernel));
+        processors.back()->SetVerbose(false);
+        options.Apply(*processors.back());
+    }
+
+    bool saved = RunImageBatch(inputSource, outputDirectory, ".bmp", numThreads,
+        [&](const std::string& file, int slot) { return processors[slot]->Load(file); },
+        [&](int slot) { processors[slot]->ProcessImageMultithread(numThreads); },
+        [&](const std::string& file, int slot) { return processors[slot]->SaveFile(file); });
+    return saved ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char* argv[]){
 
     std::string inputFilename;
     std::string outputFilename;
     int numThreads;
+    std::string kernelName = "relief";
 
-    if (argc != 4) 
+    if (argc < 4) 
     {
-        std::cout << "Usage: app_a.exe {input.bmp} {output.bmp} {numThreads}";
+        std::cout << "Usage: app_a.exe {input.bmp} {output.bmp} {numThreads} [--kernel name|kernel.txt] [--fused] [--scale factor] [--pyramid] [--stream bandRows]\n";
+        std::cout << "       app_a.exe {inputDir|list.txt} {outputDir} {numThreads} --batch [--kernel name|kernel.txt] [--fused] [--scale factor] [--pyramid]\n";
+        std::cout << "Builtin kernels:";
+        for (const std::string& name : GetBuiltinKernelNames()) std::cout << " " << name;
+        std::cout << "\n";
         return EXIT_FAILURE;
 	}
     else 
@@ -20,12 +77,53 @@ int main(int argc, char* argv[]){
         numThreads = std::stoi(argv[3]);
     }
 
-    BmpProcessor* processor = new BmpProcessor(inputFilename);
+    if (GetOption(argv, argv + argc, "--kernel")) kernelName = GetOption(argv, argv + argc, "--kernel");
+
+    ConvolutionKernel kernel;
+    if (!ResolveKernel(kernelName, kernel))
+    {
+        std::cout << "Unknown kernel: " << kernelName << "\n";
+        return EXIT_FAILURE;
+    }
+
+    OutputOptions options;
+    options.Fused = OptionExists(argv, argv + argc, "--fused");
+    options.Pyramid = OptionExists(argv, argv + argc, "--pyramid");
+    if (GetOption(argv, argv + argc, "--scale")) options.Scale = std::atof(GetOption(argv, argv + argc, "--scale"));
+    // the summed-area table sums boxes of up to 2^24 pixels exactly
+    if (!(options.Scale >= 1.0 && options.Scale <= 4096.0))
+    {
+        std::cout << "Scale has to be between 1 and 4096\n";
+        return EXIT_FAILURE;
+    }
+
+    if (OptionExists(argv, argv + argc, "--batch"))
+    {
+        return RunBatch(inputFilename, outputFilename, numThreads, kernel, options);
+    }
+
+    int bandRows = 0;
+    if (GetOption(argv, argv + argc, "--stream")) bandRows = std::max(std::atoi(GetOption(argv, argv + argc, "--stream")), 1);
+    if (bandRows > 0 && (options.Pyramid || options.Scale != 2.0))
+    {
+        std::cout << "--stream only supports the 2x minimization\n";
+        return EXIT_FAILURE;
+    }
+
+    BmpProcessor* processor = new BmpProcessor(inputFilename, kernel, &ThreadPool::Shared(numThreads), bandRows);
 
     if (!processor->GetIsReady()) return EXIT_FAILURE;
 
-    processor->ProcessImageMultithread(numThreads);
-    processor->SaveFile(outputFilename);
+    if (bandRows > 0)
+    {
+        if (!processor->ProcessStream(outputFilename, numThreads)) return EXIT_FAILURE;
+    }
+    else
+    {
+        options.Apply(*processor);
+        processor->ProcessImageMultithread(numThreads);
+        if (!processor->SaveFile(outputFilename)) return EXIT_FAILURE;
+    }
     
     std::cout << "File (" << outputFilename << ") saved \n";
 }
@@ -2,60 +2,123 @@
 
 #include <string>
 #include <vector>
-#include <thread>
 #include <chrono>
 
-struct Pixel {
-    int R;
-    int G;
-    int B;
+#include <BinaryMask.hpp>
+#include <ConnectedComponents.hpp>
+#include <ImageBuffer.hpp>
+#include <ImageIO.hpp>
+#include <MaskMorphology.hpp>
+#include <Threshold.hpp>
+#include <TileScheduler.hpp>
 
-    Pixel() = default;
-    Pixel(int initial) : R(initial), G(initial), B(initial) {} 
-    Pixel(int r, int g, int b) : R(r), G(g), B(b) {}
+#include "MorphologyPipeline.hpp"
 
-    void SetAll(int value)
-    {
-        R = value;
-        G = value;
-        B = value;
-    }
-};
+// BruteForce scans the whole window of every pixel and is only kept to check the word based modes
+enum class ErosionMode { Auto, Shift, VanHerk, BruteForce };
 
-static std::vector<Pixel>& ImageDataToPixelArray(unsigned char* imageData, int width, int height, int channels);
-
-static unsigned char* PixelArrayToImageData(const std::vector<Pixel>& pixelArray, int width, int height, int channels);
 class BmpProcessor
 {
     public:
-        BmpProcessor(const std::string& filename, int threshold = 160, int erosionStep = 1);
+        // result pixels are written as these gray levels
+        static constexpr uint8_t DarkLevel = 25;
+        static constexpr uint8_t LightLevel = 230;
+
+        // pool splits encoding of the output rows, nullptr keeps it on the calling thread.
+        // bandRows > 0 only opens the input for ProcessStream instead of loading it.
+        BmpProcessor(int threshold, int erosionStep, ThreadPool* pool = nullptr, int bandRows = 0);
+        BmpProcessor(const std::string& filename, int threshold = 160, int erosionStep = 1, ThreadPool* pool = nullptr, int bandRows = 0);
         ~BmpProcessor() = default;
 
+        // (re)loads the input, the buffers of the previous image are reused when the new one fits
+        bool Load(const std::string& filename);
+
         bool GetIsReady() { return _ready; }
 
+        // per image progress messages on stdout, errors are always printed
+        void SetVerbose(bool verbose) { _verbose = verbose; }
+
+        void SetErosionMode(ErosionMode mode);
+
+        // Otsu and Adaptive ignore the constructor threshold and derive it from the luma histogram
+        // counted while the luma plane is computed (per 64x64 block for Adaptive)
+        void SetThresholdMode(ThresholdMode mode) { _thresholdMode = mode; }
+
+        // Replaces threshold + erosion by a morphology pipeline (see MorphologyPipeline::Parse),
+        // a threshold operation without a value takes the constructor threshold and threshold mode
+        bool SetMorphology(const std::string& operations);
+
         void ProcessImageMultithread(int threadCount = 1);
 
         void ProcessImageSingleThread();
 
-        void SaveFile(const std::string& filename);
+        // file format of SaveFile and ProcessStream, written straight from the result mask
+        void SetOutputFormat(MaskFormat format) { _outputFormat = format; }
+
+        bool SaveFile(const std::string& filename);
+
+        // Labels the light pixels of the result (4 or 8 connectivity) and writes one CSV line per component:
+        // area, bounding box and centroid. Needs the whole result, not available after ProcessStream.
+        bool SaveComponents(const std::string& filename, int connectivity = 8);
+
+        // Reads the input bandRows output rows at a time (plus the rows the erosion window reaches),
+        // thresholds and erodes the band and writes it to outputFilename.
+        // Memory is bounded by the band size instead of the image size.
+        bool ProcessStream(const std::string& outputFilename, int threadCount = 1);
 
     private:
-        void ProcessImage(int startLine, int endLine);
-        bool PerformErosion(int x, int y);
+        // runs the tiles of the loaded image or of the current band, on the calling thread when pool is nullptr;
+        // collect counts the histograms for the threshold along with the luma
+        void RunPhases(int inputRows, int resultRows, ThreadPool* pool, bool collect);
+        Histogram ComputeLuma(int inputRows, ThreadPool* pool, bool collect);
+        // histogram pre-pass over the whole file for a streamed Otsu or Adaptive threshold
+        bool CollectStreamStatistics(ThreadPool& pool);
+        ThresholdMode GetThresholdMode() const;
+        int GetThresholdValue() const;
+        void ResetThresholds();
+        void ResolveThresholds(const Histogram& histogram);
+        // rows above and below a result row its input reaches
+        void GetInputHalo(int& before, int& after) const;
+        void ThresholdTile(const TileRect& tile);
+        void ErodeTile(const TileRect& tile);
+        void ErodeTileBruteForce(const TileRect& tile);
+        // clears the result mask bits of a tile past the image width
+        void ClearResultPadding(const TileRect& tile);
 
     private:
         bool _ready = false;
-        // threading and time
-        std::vector<std::thread> _threads;
+        bool _verbose = true;
+        ThreadPool* _pool = nullptr;
+        // time
         std::chrono::steady_clock::time_point _tsBegin;
         std::chrono::steady_clock::time_point _tsEnd;
 
         // image processing
         int _width, _height, _channels;
         int _intencityThreshold;
+        ThresholdMode _thresholdMode = ThresholdMode::Fixed;
+        ThresholdMap _thresholds;
         int _erosionStep;
+        ErosionMode _erosionMode = ErosionMode::Auto;
+        bool _useMorphology = false;
+        MorphologyPipeline _morphology;
+
+        DecodedImage _initialImage;
+        ImageBuffer _inputBand;
+        // channels of the loaded image or of the current band
+        ConstImageView _red, _green, _blue;
+        // luma of the same rows, what the threshold compares
+        ImageBuffer _luma;
+        // bit set where the intensity is above the threshold (the morphology pipeline keeps its masks per tile)
+        BinaryMask _mask;
+        // bit set on the light result pixels, what is saved and what the components are labelled on
+        BinaryMask _resultMask;
+        MaskFormat _outputFormat = MaskFormat::Bmp24;
 
-        std::vector<Pixel> _initialPixelArray;
-        std::vector<int> _thresholdArray;
-        std::vector<Pixel> _resultPixelArray;
+        // streaming keeps one band of input, threshold and result rows,
+        // the first image row each of them holds (0 when the whole image is loaded)
+        int _bandRows = 0;
+        int _inputFirstRow = 0;
+        int _resultFirstRow = 0;
+        BmpBandReader _reader;
 };
\ No newline at end of file
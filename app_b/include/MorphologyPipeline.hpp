@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <BinaryMask.hpp>
+#include <ImageView.hpp>
+#include <MaskMorphology.hpp>
+#include <StructuringElement.hpp>
+#include <Threshold.hpp>
+#include <TileScheduler.hpp>
+
+// Threshold followed by a chain of binary morphology operations, run tile by tile:
+// every output tile thresholds the input region all the operations reach and applies them one after another
+// to tile sized masks, so intermediate masks stay in cache and are never allocated for the whole image.
+class MorphologyPipeline
+{
+    public:
+        // Comma separated operations: "threshold[:value|otsu|adaptive]" (first, the defaults when missing or without value),
+        // "erode:se", "dilate:se", "open:se", "close:se", "gradient[:se]" (3x3 square by default),
+        // se as accepted by ResolveStructuringElement.
+        bool Parse(const std::string& spec, ThresholdMode defaultMode, int defaultThreshold);
+
+        ThresholdMode GetThresholdMode() const { return _thresholdMode; }
+        int GetThreshold() const { return _threshold; }
+
+        // e.g. "threshold:otsu,erode:square5,dilate:square5"
+        std::string Describe() const;
+
+        void SetMethod(MorphologyMethod method) { _method = method; }
+
+        // rows above and below an output pixel the pipeline reads
+        int GetHaloTop() const { return _haloTop; }
+        int GetHaloBottom() const { return _haloBottom; }
+
+        // Tile size keeping the recomputed halo a fraction of the tile
+        void GetTileSize(int& tileWidth, int& tileHeight) const;
+
+        // Writes the final mask of tile (image coordinates, X0 on a word boundary) to dst, the words of image row tile.Y0,
+        // rows dstStride words apart. luma holds image rows [lumaFirstRow, lumaFirstRow + luma.Height),
+        // which must cover the rows the tile reads; thresholds is resolved for the threshold operation.
+        void RunTile(const ConstImageView& luma, int lumaFirstRow, int imageWidth, int imageHeight, const ThresholdMap& thresholds,
+                     const TileRect& tile, uint64_t* dst, size_t dstStride) const;
+
+    private:
+        enum class StepType { Erode, Dilate, Gradient };
+
+        struct Step {
+            StepType Type;
+            StructuringElement Element;
+            // pixels the step reads around an output pixel
+            int Left, Right, Top, Bottom;
+        };
+
+        bool AddOperation(const std::string& name, const std::string& argument);
+        void AddStep(StepType type, const StructuringElement& element);
+
+    private:
+        ThresholdMode _thresholdMode = ThresholdMode::Fixed;
+        int _threshold = 0;
+        std::vector<std::string> _operations;
+        std::vector<Step> _steps;
+        int _haloTop = 0;
+        int _haloBottom = 0;
+        int _haloLeft = 0;
+        int _haloRight = 0;
+        MorphologyMethod _method = MorphologyMethod::Auto;
+};
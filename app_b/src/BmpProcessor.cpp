@@ -1,144 +1,409 @@
 #include "BmpProcessor.hpp"
 
+#include <algorithm>
 #include <iostream>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
+BmpProcessor::BmpProcessor(int intensityThreshold, int erosionStep, ThreadPool* pool, int bandRows) :
+    _pool(pool),
+    _intencityThreshold(intensityThreshold),
+    _erosionStep(erosionStep),
+    _bandRows(bandRows)
+{
+}
+
+BmpProcessor::BmpProcessor(const std::string& filename, int intensityThreshold, int erosionStep, ThreadPool* pool, int bandRows) :
+    BmpProcessor(intensityThreshold, erosionStep, pool, bandRows)
+{
+    Load(filename);
+}
 
-static std::vector<Pixel>& ImageDataToPixelArray(unsigned char* imageData, int width, int height, int channels)
+bool BmpProcessor::Load(const std::string& filename)
 {
-    std::vector<Pixel>* pixelArray = new std::vector<Pixel>();
+    _ready = false;
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            Pixel px(
-                (int)imageData[y * width * channels + x * channels],    
-                (int)imageData[y * width * channels + x * channels + 1],
-                (int)imageData[y * width * channels + x * channels + 2]
-            );
-            pixelArray->push_back(px);
-        }
+    if (_bandRows > 0)
+    {
+        if (!_reader.Open(filename)) return false;
+
+        _width = _reader.GetWidth();
+        _height = _reader.GetHeight();
+        _channels = _reader.GetSourceChannels();
+    }
+    else
+    {
+        if (!_initialImage.Load(filename, 3)) return false;
+
+        _width = _initialImage.GetWidth();
+        _height = _initialImage.GetHeight();
+        _channels = _initialImage.GetSourceChannels();
+        _red = _initialImage.Channel(0);
+        _green = _initialImage.Channel(1);
+        _blue = _initialImage.Channel(2);
     }
+    
+    if (_verbose) std::cout << "Image: " << filename << "; Width: " << _width << "; Height: " << _height << "; Number of channels: " << _channels << "\n";
+
+    _ready = true;
+    return true;
+}
+
+void BmpProcessor::SetErosionMode(ErosionMode mode)
+{
+    _erosionMode = mode;
+    _morphology.SetMethod(mode == ErosionMode::Shift ? MorphologyMethod::Shift
+                        : mode == ErosionMode::VanHerk ? MorphologyMethod::VanHerk
+                        : MorphologyMethod::Auto);
+}
+
+bool BmpProcessor::SetMorphology(const std::string& operations)
+{
+    _useMorphology = _morphology.Parse(operations, _thresholdMode, _intencityThreshold);
+    if (_useMorphology && _verbose) std::cout << "Morphology: " << _morphology.Describe() << "\n";
+    return _useMorphology;
+}
+
+void BmpProcessor::ProcessImageMultithread(int threadCount)
+{
+    if (_verbose) std::cout << "Started processing with " << threadCount << " thread(s)" << std::endl;
+    _tsBegin = std::chrono::steady_clock::now();
+
+    ResetThresholds();
+    RunPhases(_height, _height, &ThreadPool::Shared(threadCount), GetThresholdMode() != ThresholdMode::Fixed);
+
+    _tsEnd = std::chrono::steady_clock::now();
+
+    if (_verbose) std::cout << "Ended processing. Time elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(_tsEnd - _tsBegin).count() << " ms" << std::endl;
+}
+
+ThresholdMode BmpProcessor::GetThresholdMode() const
+{
+    return _useMorphology ? _morphology.GetThresholdMode() : _thresholdMode;
+}
 
-    return *pixelArray;
+int BmpProcessor::GetThresholdValue() const
+{
+    return _useMorphology ? _morphology.GetThreshold() : _intencityThreshold;
 }
 
-static unsigned char* PixelArrayToImageData(const std::vector<Pixel>& pixelArray, int width, int height, int channels)
+void BmpProcessor::ResetThresholds()
 {
-    unsigned char* imageData = (unsigned char *) malloc(height * width * channels);
+    bool adaptive = GetThresholdMode() == ThresholdMode::Adaptive;
+    _thresholds.ResizeBlocks(adaptive ? _width : 0, adaptive ? _height : 0);
+    _thresholds.SetGlobal(GetThresholdValue());
+}
+
+void BmpProcessor::ResolveThresholds(const Histogram& histogram)
+{
+    // adaptive blocks too flat for their own threshold fall back to the image one
+    _thresholds.SetGlobal(OtsuThreshold(histogram));
+    if (_verbose) std::cout << "Threshold: " << DescribeThreshold(GetThresholdMode(), 0) << " -> " << _thresholds.GetGlobal() << "\n";
+}
+
+// Luma of input rows [0, inputRows) into _luma, one block row (ThresholdMap::BlockSize rows) per task.
+// With collect the rows must start on a block row: the histogram of every block is counted in the same pass,
+// adaptive blocks get their threshold right away and the per-task histograms are summed into the returned one.
+Histogram BmpProcessor::ComputeLuma(int inputRows, ThreadPool* pool, bool collect)
+{
+    const int blockSize = ThresholdMap::BlockSize;
+    const size_t blockRows = (inputRows + blockSize - 1) / blockSize;
+    const bool adaptive = collect && _thresholds.HasBlocks();
+    _luma.Resize(_width, inputRows, 1);
+
+    auto map = [&](size_t firstBlockRow, size_t endBlockRow) {
+        Histogram histogram{};
+        std::vector<Histogram> blocks(adaptive ? _thresholds.GetBlocksX() : 0);
+        for (size_t blockRow = firstBlockRow; blockRow < endBlockRow; blockRow++)
+        {
+            int firstY = (int)blockRow * blockSize;
+            int endY = std::min(firstY + blockSize, inputRows);
+            for (Histogram& block : blocks) block.fill(0);
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            imageData[y * width * channels + x * channels] = pixelArray[y * width + x].R;
-            imageData[y * width * channels + x * channels + 1] = pixelArray[y * width + x].G;
-            imageData[y * width * channels + x * channels + 2] = pixelArray[y * width + x].B;
+            for (int y = firstY; y < endY; y++)
+            {
+                uint8_t* luma = _luma.Row(0, y);
+                LumaRow(_red, _green, _blue, y, luma);
+
+                if (adaptive)
+                {
+                    for (int blockX = 0; blockX < (int)blocks.size(); blockX++)
+                    {
+                        Histogram& block = blocks[blockX];
+                        for (int x = blockX * blockSize; x < std::min((blockX + 1) * blockSize, _width); x++) block[luma[x]]++;
+                    }
+                }
+                else if (collect)
+                {
+                    for (int x = 0; x < _width; x++) histogram[luma[x]]++;
+                }
+            }
+
+            for (int blockX = 0; blockX < (int)blocks.size(); blockX++)
+            {
+                _thresholds.SetBlock(blockX, (firstY + _inputFirstRow) / blockSize, blocks[blockX]);
+                for (int value = 0; value < 256; value++) histogram[value] += blocks[blockX][value];
+            }
+        }
+        return histogram;
+    };
+
+    auto combine = [](Histogram sum, const Histogram& partial) {
+        for (int value = 0; value < 256; value++) sum[value] += partial[value];
+        return sum;
+    };
+
+    if (pool) return pool->ParallelReduce(size_t(0), blockRows, Histogram{}, map, combine, 1);
+    return map(0, blockRows);
+}
+
+bool BmpProcessor::CollectStreamStatistics(ThreadPool& pool)
+{
+    // whole block rows per read so every block is counted in one piece
+    const int blockSize = ThresholdMap::BlockSize;
+    const int rows = (_bandRows + blockSize - 1) / blockSize * blockSize;
+
+    Histogram total{};
+    for (int firstRow = 0; firstRow < _height; firstRow += rows)
+    {
+        int rowCount = std::min(rows, _height - firstRow);
+        if (!_reader.ReadRows(firstRow, rowCount, _inputBand, 3, &pool))
+        {
+            std::cout << "Failed to read rows " << firstRow << ".." << firstRow + rowCount << "\n";
+            return false;
         }
+
+        _red = _inputBand.View(0);
+        _green = _inputBand.View(1);
+        _blue = _inputBand.View(2);
+        _inputFirstRow = firstRow;
+
+        Histogram band = ComputeLuma(rowCount, &pool, true);
+        for (int value = 0; value < 256; value++) total[value] += band[value];
     }
 
-    return imageData;
+    ResolveThresholds(total);
+    return true;
+}
+
+void BmpProcessor::GetInputHalo(int& before, int& after) const
+{
+    if (_useMorphology)
+    {
+        before = _morphology.GetHaloTop();
+        after = _morphology.GetHaloBottom();
+    }
+    else
+    {
+        before = _erosionStep / 2;
+        after = _erosionStep - 1 - before;
+    }
 }
 
-BmpProcessor::BmpProcessor(const std::string& filename, int intensityThreshold, int erosionStep) :
-    _intencityThreshold(intensityThreshold),
-    _erosionStep(erosionStep)
+// Threshold tiles are numbered from _inputFirstRow, erosion and pipeline tiles from _resultFirstRow
+void BmpProcessor::RunPhases(int inputRows, int resultRows, ThreadPool* pool, bool collect)
 {
-    unsigned char* imageData = stbi_load(filename.c_str(), &_width, &_height, &_channels, 3);
+    Histogram histogram = ComputeLuma(inputRows, pool, collect);
+    if (collect) ResolveThresholds(histogram);
 
-    if (!imageData)
+    if (_useMorphology)
     {
-        std::cout << "Failed to load image";
+        int tileWidth, tileHeight;
+        _morphology.GetTileSize(tileWidth, tileHeight);
+
+        _resultMask.Resize(_width, resultRows);
+
+        // one phase: every tile thresholds and transforms its own input region
+        TileScheduler scheduler(tileWidth, tileHeight);
+        scheduler.AddPhase(_width, resultRows, [this](const TileRect& tile) {
+            TileRect imageTile{ tile.X0, tile.Y0 + _resultFirstRow, tile.X1, tile.Y1 + _resultFirstRow };
+            _morphology.RunTile(_luma.View(0), _inputFirstRow, _width, _height, _thresholds, imageTile,
+                                _resultMask.Row(tile.Y0) + tile.X0 / BinaryMask::WordBits, _resultMask.GetWordsPerRow());
+            ClearResultPadding(tile);
+        });
+
+        if (pool) scheduler.Run(*pool);
+        else scheduler.RunSequential();
         return;
     }
-    
-    std::cout << "Image: " << filename << "; Width: " << _width << "; Height: " << _height << "; Number of channels: " << _channels << "\n";
-    
-    _initialPixelArray = ImageDataToPixelArray(imageData, _width, _height, _channels);
 
-    _thresholdArray.resize(_height * _width);
-    _resultPixelArray.resize(_height * _width);
+    _mask.Resize(_width, inputRows);
+    _resultMask.Resize(_width, resultRows);
 
-    stbi_image_free(imageData);
+    TileScheduler scheduler;
+    scheduler.AddPhase(_width, inputRows, [this](const TileRect& tile) { ThresholdTile(tile); });
+    // erosion of a tile reads the threshold window around every pixel
+    scheduler.AddPhase(_width, resultRows, [this](const TileRect& tile) { ErodeTile(tile); },
+        [this](const TileRect& tile) {
+            int before, after;
+            GetInputHalo(before, after);
+            int shift = _resultFirstRow - _inputFirstRow;
+            return TileRect{ tile.X0 - before, tile.Y0 + shift - before, tile.X1 + after, tile.Y1 + shift + after };
+        });
 
-    _ready = true;
+    if (pool) scheduler.Run(*pool);
+    else scheduler.RunSequential();
 }
 
-void BmpProcessor::ProcessImageMultithread(int threadCount)
+bool BmpProcessor::ProcessStream(const std::string& outputFilename, int threadCount)
 {
-    std::cout << "Started processing with " << threadCount << " thread(s)" << std::endl;
+    std::cout << "Started streaming with " << threadCount << " thread(s), " << _bandRows << " row(s) per band" << std::endl;
     _tsBegin = std::chrono::steady_clock::now();
 
-    int step = _height / threadCount;
-    for (int i = 0; i < threadCount; i++)
-    {
-        int start = i * step;
-        int end = (i + 1) * step + 1;
-        _threads.push_back(std::thread(&BmpProcessor::ProcessImage, this, start, end));
-    }
+    ThreadPool& pool = ThreadPool::Shared(threadCount);
+    MaskWriter writer;
+    if (!writer.Open(outputFilename, _width, _height, _outputFormat, DarkLevel, LightLevel)) return false;
+
+    ResetThresholds();
+    if (GetThresholdMode() != ThresholdMode::Fixed && !CollectStreamStatistics(pool)) return false;
+
+    int before, after;
+    GetInputHalo(before, after);
 
-    for (auto& thread : _threads)
+    for (int firstRow = 0; firstRow < _height; firstRow += _bandRows)
     {
-        if (thread.joinable()) thread.join();
+        int endRow = std::min(firstRow + _bandRows, _height);
+        int inputBegin = std::max(firstRow - before, 0);
+        int inputEnd = std::min(endRow + after, _height);
+
+        if (!_reader.ReadRows(inputBegin, inputEnd - inputBegin, _inputBand, 3, &pool))
+        {
+            std::cout << "Failed to read rows " << inputBegin << ".." << inputEnd << "\n";
+            return false;
+        }
+
+        _red = _inputBand.View(0);
+        _green = _inputBand.View(1);
+        _blue = _inputBand.View(2);
+        _inputFirstRow = inputBegin;
+        _resultFirstRow = firstRow;
+
+        RunPhases(inputEnd - inputBegin, endRow - firstRow, &pool, false);
+
+        if (!writer.WriteRows(_resultMask, 0, endRow - firstRow, &pool)) break;
     }
 
+    bool written = writer.Close();
+    if (!written) std::cerr << "Couldn't write file: " << outputFilename << "\n";
+
     _tsEnd = std::chrono::steady_clock::now();
 
     std::cout << "Ended processing. Time elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(_tsEnd - _tsBegin).count() << " ms" << std::endl;
+    return written;
 }
 
-void BmpProcessor::ProcessImage(int startLine, int endLine)
+// Tiles start on multiples of 64 pixels (the tile width is), so every mask word is written by one tile only
+void BmpProcessor::ThresholdTile(const TileRect& tile)
 {
-    for (int y = startLine; y < endLine && y < _height; y++) 
+    for (int y = tile.Y0; y < tile.Y1; y++) 
     {
-        for (int x = 0; x < _width; x++) 
-        {
-            int intensity = (_initialPixelArray[y * _width + x].R +
-                             _initialPixelArray[y * _width + x].R +
-                             _initialPixelArray[y * _width + x].R) / 3;
-            
-            if (intensity > _intencityThreshold) _thresholdArray[y * _width + x] = 1;
-            else _thresholdArray[y * _width + x] = 0;
-        }
+        _thresholds.Pack(_luma.Row(0, y) + tile.X0, tile.X0, y + _inputFirstRow, tile.X1 - tile.X0,
+                         _mask.Row(y) + tile.X0 / BinaryMask::WordBits);
+    }
+}
+
+// A result pixel is dark when no mask bit is set in its erosionStep x erosionStep window.
+// The window OR is separable: the mask rows of the tile and its halo are dilated horizontally 64 pixels at a time,
+// then the dilated rows are ORed vertically word by word.
+void BmpProcessor::ErodeTile(const TileRect& tile)
+{
+    if (_erosionMode == ErosionMode::BruteForce)
+    {
+        ErodeTileBruteForce(tile);
+        return;
     }
 
-    for (int y = startLine; y < endLine && y < _height; y ++) 
+    const MorphologyMethod method = _erosionMode == ErosionMode::Shift ? MorphologyMethod::Shift
+                                  : _erosionMode == ErosionMode::VanHerk ? MorphologyMethod::VanHerk
+                                  : MorphologyMethod::Auto;
+    const int before = _erosionStep / 2;
+    const int after = _erosionStep - 1 - before;
+    const int wordsPerRow = _mask.GetWordsPerRow();
+    const int firstWord = tile.X0 / BinaryMask::WordBits;
+    const int wordCount = BinaryMask::WordCount(tile.X1) - firstWord;
+
+    // image rows of the tile and its vertical halo
+    const int firstY = tile.Y0 + _resultFirstRow;
+    const int endY = tile.Y1 + _resultFirstRow;
+    const int haloBegin = std::max(firstY - before, 0);
+    const int haloEnd = std::min(endY + after, _height);
+    const int haloRows = std::max(haloEnd - haloBegin, 0);
+
+    static thread_local std::vector<uint64_t> rows, window;
+    rows.resize((size_t)haloRows * wordCount);
+    window.resize((size_t)(endY - firstY) * wordCount);
+
+    for (int y = haloBegin; y < haloEnd; y++)
     {
-        for (int x = 0; x < _width; x ++) 
-        {
-            if (PerformErosion(x, y)) _resultPixelArray[y * _width + x].SetAll(25);
-            else _resultPixelArray[y * _width + x].SetAll(230);
-        }
+        DilateRowSpan(_mask.Row(y - _inputFirstRow), wordsPerRow, firstWord * BinaryMask::WordBits, wordCount, before, after,
+                      rows.data() + (size_t)(y - haloBegin) * wordCount, method);
     }
+
+    DilateColumnSpan(rows.data(), wordCount, haloRows, wordCount, before, after,
+                     firstY - haloBegin, endY - firstY, window.data(), wordCount, method);
+
+    // the words past the image width are cut back by ClearResultPadding
+    for (int y = firstY; y < endY; y++)
+    {
+        const uint64_t* windowRow = window.data() + (size_t)(y - firstY) * wordCount;
+        std::copy(windowRow, windowRow + wordCount, _resultMask.Row(y - _resultFirstRow) + firstWord);
+    }
+    ClearResultPadding(tile);
 }
 
-bool BmpProcessor::PerformErosion(int x, int y)
+void BmpProcessor::ErodeTileBruteForce(const TileRect& tile)
 {
-    for (int coreY = 0; coreY < _erosionStep; coreY++)
+    const int before = _erosionStep / 2;
+    const int after = _erosionStep - 1 - before;
+
+    for (int y = tile.Y0 + _resultFirstRow; y < tile.Y1 + _resultFirstRow; y++)
     {
-        for (int coreX = 0; coreX < _erosionStep; coreX++)
+        uint64_t* result = _resultMask.Row(y - _resultFirstRow);
+        for (int x = tile.X0; x < tile.X1; x++)
         {
-            int pixelX = x + (coreX - _erosionStep / 2);
-            int pixelY = y + (coreY - _erosionStep / 2);
-            
-            if (pixelX < 0 || pixelX >= _width || pixelY < 0 || pixelY >= _height) continue;
-
-            if (_thresholdArray[pixelY * _width + pixelX] == 1) return false;
+            bool found = false;
+            for (int windowY = std::max(y - before, 0); windowY < std::min(y + after + 1, _height) && !found; windowY++)
+            {
+                for (int windowX = std::max(x - before, 0); windowX < std::min(x + after + 1, _width) && !found; windowX++)
+                {
+                    found = _mask.Get(windowX, windowY - _inputFirstRow);
+                }
+            }
+            result[x / BinaryMask::WordBits] |= (uint64_t)found << (x % BinaryMask::WordBits);
         }
     }
-    return true;
 }
 
-void BmpProcessor::ProcessImageSingleThread()
+// Tiles start on word boundaries, so the result mask words of a tile belong to it alone
+void BmpProcessor::ClearResultPadding(const TileRect& tile)
 {
-    ProcessImage(0, _height);
-    
+    const int used = tile.X1 % BinaryMask::WordBits;
+    if (tile.X1 != _width || !used) return;
+
+    const int lastWord = BinaryMask::WordCount(tile.X1) - 1;
+    for (int y = tile.Y0; y < tile.Y1; y++) _resultMask.Row(y)[lastWord] &= (uint64_t(1) << used) - 1;
+}
+
+bool BmpProcessor::SaveComponents(const std::string& filename, int connectivity)
+{
+    auto tsBegin = std::chrono::steady_clock::now();
+    std::vector<ComponentStats> components = LabelComponents(_resultMask, connectivity, _pool);
+    auto tsEnd = std::chrono::steady_clock::now();
+
+    if (_verbose)
+    {
+        std::cout << "Components: " << components.size() << " (" << connectivity << "-connected). Time elapsed: "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(tsEnd - tsBegin).count() << " ms" << std::endl;
+    }
+    return WriteComponentsCsv(filename, components);
 }
 
-void BmpProcessor::SaveFile(const std::string& filename)
+void BmpProcessor::ProcessImageSingleThread()
 {
-    unsigned char* imageData = PixelArrayToImageData(_resultPixelArray, _width, _height, _channels);
+    ResetThresholds();
+    RunPhases(_height, _height, nullptr, GetThresholdMode() != ThresholdMode::Fixed);
+}
 
-    stbi_write_bmp((filename).c_str(), _width, _height, 3, (const void*)imageData);
+bool BmpProcessor::SaveFile(const std::string& filename)
+{
+    return SaveMask(filename, _resultMask, _outputFormat, DarkLevel, LightLevel, _pool);
 }
\ No newline at end of file
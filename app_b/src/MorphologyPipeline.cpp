@@ -0,0 +1,203 @@
+#include "MorphologyPipeline.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+bool MorphologyPipeline::Parse(const std::string& spec, ThresholdMode defaultMode, int defaultThreshold)
+{
+    _thresholdMode = defaultMode;
+    _threshold = defaultThreshold;
+    _operations.clear();
+    _steps.clear();
+
+    std::istringstream stream(spec);
+    bool first = true;
+    for (std::string token; std::getline(stream, token, ',');)
+    {
+        if (token.empty()) continue;
+
+        size_t colon = token.find(':');
+        std::string name = token.substr(0, colon);
+        std::string argument = colon == std::string::npos ? "" : token.substr(colon + 1);
+
+        if (name == "threshold" && !first)
+        {
+            std::cout << "threshold must be the first operation: " << spec << "\n";
+            return false;
+        }
+        if (first && name != "threshold") _operations.push_back("threshold:" + DescribeThreshold(_thresholdMode, _threshold));
+        first = false;
+
+        if (!AddOperation(name, argument)) return false;
+    }
+
+    if (_operations.empty()) _operations.push_back("threshold:" + DescribeThreshold(_thresholdMode, _threshold));
+
+    _haloLeft = _haloRight = _haloTop = _haloBottom = 0;
+    for (const Step& step : _steps)
+    {
+        _haloLeft += step.Left;
+        _haloRight += step.Right;
+        _haloTop += step.Top;
+        _haloBottom += step.Bottom;
+    }
+    return true;
+}
+
+bool MorphologyPipeline::AddOperation(const std::string& name, const std::string& argument)
+{
+    if (name == "threshold")
+    {
+        if (!argument.empty() && !ParseThreshold(argument, _thresholdMode, _threshold)) return false;
+        _operations.push_back("threshold:" + DescribeThreshold(_thresholdMode, _threshold));
+        return true;
+    }
+
+    if (name != "erode" && name != "dilate" && name != "open" && name != "close" && name != "gradient")
+    {
+        std::cout << "Unknown morphology operation: " << name << " (expected threshold, erode, dilate, open, close or gradient)\n";
+        return false;
+    }
+
+    StructuringElement element;
+    if (argument.empty() && name == "gradient") element = MakeSquareElement(3);
+    else if (argument.empty())
+    {
+        std::cout << name << " needs a structuring element, e.g. " << name << ":5\n";
+        return false;
+    }
+    else if (!ResolveStructuringElement(argument, element)) return false;
+
+    if (name == "erode") AddStep(StepType::Erode, element);
+    else if (name == "dilate") AddStep(StepType::Dilate, element);
+    else if (name == "open")
+    {
+        AddStep(StepType::Erode, element);
+        AddStep(StepType::Dilate, element);
+    }
+    else if (name == "close")
+    {
+        AddStep(StepType::Dilate, element);
+        AddStep(StepType::Erode, element);
+    }
+    else AddStep(StepType::Gradient, element);
+
+    _operations.push_back(name + ":" + element.Name);
+    return true;
+}
+
+void MorphologyPipeline::AddStep(StepType type, const StructuringElement& element)
+{
+    // extent of the set cells around the origin
+    int minX = element.Width, maxX = -1, minY = element.Height, maxY = -1;
+    for (int y = 0; y < element.Height; y++)
+    {
+        for (int x = 0; x < element.Width; x++)
+        {
+            if (!element.At(x, y)) continue;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+    }
+    minX -= element.OriginX;
+    maxX -= element.OriginX;
+    minY -= element.OriginY;
+    maxY -= element.OriginY;
+
+    // erosion reads the element placed on the pixel, dilation its reflection, the gradient both
+    Step step{ type, element, 0, 0, 0, 0 };
+    if (type != StepType::Dilate)
+    {
+        step.Left = std::max(step.Left, -minX);
+        step.Right = std::max(step.Right, maxX);
+        step.Top = std::max(step.Top, -minY);
+        step.Bottom = std::max(step.Bottom, maxY);
+    }
+    if (type != StepType::Erode)
+    {
+        step.Left = std::max(step.Left, maxX);
+        step.Right = std::max(step.Right, -minX);
+        step.Top = std::max(step.Top, maxY);
+        step.Bottom = std::max(step.Bottom, -minY);
+    }
+    _steps.push_back(step);
+}
+
+std::string MorphologyPipeline::Describe() const
+{
+    std::string description;
+    for (const std::string& operation : _operations)
+    {
+        if (!description.empty()) description += ",";
+        description += operation;
+    }
+    return description;
+}
+
+void MorphologyPipeline::GetTileSize(int& tileWidth, int& tileHeight) const
+{
+    // the halo is recomputed by every tile, tiles at least twice as large keep that below 2x per axis
+    tileWidth = std::max(256, (2 * (_haloLeft + _haloRight) + BinaryMask::WordBits - 1) / BinaryMask::WordBits * BinaryMask::WordBits);
+    tileHeight = std::max(64, 2 * (_haloTop + _haloBottom));
+}
+
+void MorphologyPipeline::RunTile(const ConstImageView& luma, int lumaFirstRow, int imageWidth, int imageHeight, const ThresholdMap& thresholds,
+                                 const TileRect& tile, uint64_t* dst, size_t dstStride) const
+{
+    // regions[i] is the area step i reads, regions.back() the tile itself
+    std::vector<TileRect> regions(_steps.size() + 1);
+    regions.back() = tile;
+    for (int i = (int)_steps.size() - 1; i >= 0; i--)
+    {
+        const TileRect& out = regions[i + 1];
+        const Step& step = _steps[i];
+        regions[i] = { std::max(out.X0 - step.Left, 0), std::max(out.Y0 - step.Top, 0),
+                       std::min(out.X1 + step.Right, imageWidth), std::min(out.Y1 + step.Bottom, imageHeight) };
+    }
+
+    static thread_local BinaryMask masks[2], eroded;
+    BinaryMask* current = &masks[0];
+    BinaryMask* next = &masks[1];
+
+    const TileRect& input = regions.front();
+    current->Resize(input.X1 - input.X0, input.Y1 - input.Y0);
+    for (int y = input.Y0; y < input.Y1; y++)
+    {
+        thresholds.Pack(luma.Row(y - lumaFirstRow) + input.X0, input.X0, y, input.X1 - input.X0, current->Row(y - input.Y0));
+    }
+
+    for (size_t i = 0; i < _steps.size(); i++)
+    {
+        const Step& step = _steps[i];
+        const TileRect& from = regions[i];
+        const TileRect& to = regions[i + 1];
+        const int offsetX = to.X0 - from.X0;
+        const int offsetY = to.Y0 - from.Y0;
+
+        next->Resize(to.X1 - to.X0, to.Y1 - to.Y0);
+        if (step.Type == StepType::Erode) ErodeMask(*current, offsetX, offsetY, step.Element, *next, _method);
+        else if (step.Type == StepType::Dilate) DilateMask(*current, offsetX, offsetY, step.Element, *next, _method);
+        else
+        {
+            // morphological gradient: dilation minus erosion, the boundary pixels on both sides of every edge
+            DilateMask(*current, offsetX, offsetY, step.Element, *next, _method);
+            eroded.Resize(next->GetWidth(), next->GetHeight());
+            ErodeMask(*current, offsetX, offsetY, step.Element, eroded, _method);
+            for (int y = 0; y < next->GetHeight(); y++)
+            {
+                uint64_t* row = next->Row(y);
+                const uint64_t* erodedRow = eroded.Row(y);
+                for (int word = 0; word < next->GetWordsPerRow(); word++) row[word] &= ~erodedRow[word];
+            }
+        }
+        std::swap(current, next);
+    }
+
+    for (int y = 0; y < current->GetHeight(); y++)
+    {
+        std::copy(current->Row(y), current->Row(y) + current->GetWordsPerRow(), dst + y * dstStride);
+    }
+}
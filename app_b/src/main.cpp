@@ -1,39 +1,141 @@
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <vector>
+
+#include <ImageBatch.hpp>
 
 #include "BmpProcessor.hpp"
 
+// every image of inputSource is thresholded and eroded with the same options into outputDirectory
+int RunBatch(const std::string& inputSource, const std::string& outputDirectory, int numThreads, int intencityThreshold, ThresholdMode thresholdMode,
+             int erosionStep, ErosionMode erosionMode, const std::string& operations, MaskFormat outputFormat)
+{
+    std::vector<std::unique_ptr<BmpProcessor>> processors;
+    for (int slot = 0; slot < BatchSlotCount; slot++)
+    {
+        processors.push_back(std::make_unique<BmpProcessor>(intencityThreshold, erosionStep));
+        processors.back()->SetVerbose(false);
+        processors.back()->SetErosionMode(erosionMode);
+        processors.back()->SetThresholdMode(thresholdMode);
+        processors.back()->SetOutputFormat(outputFormat);
+        if (!operations.empty() && !processors.back()->SetMorphology(operations)) return EXIT_FAILURE;
+    }
+
+    bool saved = RunImageBatch(inputSource, outputDirectory, MaskFormatExtension(outputFormat), numThreads,
+        [&](const std::string& file, int slot) { return processors[slot]->Load(file); },
+        [&](int slot) { processors[slot]->ProcessImageMultithread(numThreads); },
+        [&](const std::string& file, int slot) { return processors[slot]->SaveFile(file); });
+    return saved ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool ParseErosionMode(const std::string& name, ErosionMode& mode)
+{
+    if (name == "auto") mode = ErosionMode::Auto;
+    else if (name == "shift") mode = ErosionMode::Shift;
+    else if (name == "vhgw") mode = ErosionMode::VanHerk;
+    else if (name == "brute") mode = ErosionMode::BruteForce;
+    else
+    {
+        std::cout << "Unknown erosion mode: " << name << " (expected auto, shift, vhgw or brute)\n";
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]){
 
     std::string inputFilename;
     std::string outputFilename;
     int numThreads;
     int intencityThreshold = 100;
+    ThresholdMode thresholdMode = ThresholdMode::Fixed;
     int erosionStep = 2;
+    int bandRows = 0;
+    bool batch = false;
+    ErosionMode erosionMode = ErosionMode::Auto;
+    std::string operations;
+    std::string componentsFilename;
+    int connectivity = 8;
+    std::string formatName;
+
+    // --stream {bandRows}, --erosion {mode}, --ops {operations}, --components {file.csv}, --connectivity {4|8},
+    // --format {bmp|bmp1|pbm|png} and --batch go after the positional arguments
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--stream" && i + 1 < argc) bandRows = std::max(std::atoi(argv[++i]), 1);
+        else if (arg == "--erosion" && i + 1 < argc)
+        {
+            if (!ParseErosionMode(argv[++i], erosionMode)) return EXIT_FAILURE;
+        }
+        else if (arg == "--ops" && i + 1 < argc) operations = argv[++i];
+        else if (arg == "--components" && i + 1 < argc) componentsFilename = argv[++i];
+        else if (arg == "--connectivity" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value != "4" && value != "8")
+            {
+                std::cout << "Unknown connectivity: " << value << " (expected 4 or 8)\n";
+                return EXIT_FAILURE;
+            }
+            connectivity = value == "4" ? 4 : 8;
+        }
+        else if (arg == "--format" && i + 1 < argc) formatName = argv[++i];
+        else if (arg == "--batch") batch = true;
+        else positional.push_back(arg);
+    }
     
-    if (argc != 4 && argc != 6) 
+    if (positional.size() != 3 && positional.size() != 5) 
     {
-        std::cout << "Usage: app_b.exe {input.bmp} {output.bmp} {numThreads} [intencityThreshold] [erosionStep]";
+        std::cout << "Usage: app_b.exe {input.bmp} {output.bmp} {numThreads} [intencityThreshold|otsu|adaptive] [erosionStep] [--erosion auto|shift|vhgw|brute] [--ops operations] [--components file.csv] [--connectivity 4|8] [--format bmp|bmp1|pbm|png] [--stream bandRows]\n";
+        std::cout << "       app_b.exe {inputDir|list.txt} {outputDir} {numThreads} [intencityThreshold] [erosionStep] [--erosion mode] [--ops operations] [--format name] --batch";
         return EXIT_FAILURE;
 	}
     else
     {
-        inputFilename = argv[1];
-        outputFilename = argv[2];
-        numThreads = std::stoi(argv[3]);
+        inputFilename = positional[0];
+        outputFilename = positional[1];
+        numThreads = std::stoi(positional[2]);
+    }
+
+    if (positional.size() == 5)
+    {
+        if (!ParseThreshold(positional[3], thresholdMode, intencityThreshold)) return EXIT_FAILURE;
+        erosionStep = std::atoi(positional[4].c_str());
     }
 
-    if (argc == 6)
+    // without --format the output extension picks it (a batch writes 24-bit BMPs)
+    MaskFormat outputFormat = batch ? MaskFormat::Bmp24 : MaskFormatFromFilename(outputFilename);
+    if (!formatName.empty() && !ParseMaskFormat(formatName, outputFormat)) return EXIT_FAILURE;
+
+    if (!componentsFilename.empty() && (batch || bandRows > 0))
     {
-        intencityThreshold = std::atoi(argv[4]);
-        erosionStep = std::atoi(argv[5]);
+        std::cout << "--components needs a single image processed in memory (no --batch or --stream)\n";
+        return EXIT_FAILURE;
     }
 
-    BmpProcessor* processor = new BmpProcessor(inputFilename, intencityThreshold, erosionStep);
+    if (batch) return RunBatch(inputFilename, outputFilename, numThreads, intencityThreshold, thresholdMode, erosionStep, erosionMode, operations, outputFormat);
+
+    BmpProcessor* processor = new BmpProcessor(inputFilename, intencityThreshold, erosionStep, &ThreadPool::Shared(numThreads), bandRows);
 
     if (!processor->GetIsReady()) return EXIT_FAILURE;
+    processor->SetErosionMode(erosionMode);
+    processor->SetThresholdMode(thresholdMode);
+    processor->SetOutputFormat(outputFormat);
+    if (!operations.empty() && !processor->SetMorphology(operations)) return EXIT_FAILURE;
 
-    processor->ProcessImageMultithread(numThreads);
-    processor->SaveFile(outputFilename);
+    if (bandRows > 0)
+    {
+        if (!processor->ProcessStream(outputFilename, numThreads)) return EXIT_FAILURE;
+    }
+    else
+    {
+        processor->ProcessImageMultithread(numThreads);
+        if (!processor->SaveFile(outputFilename)) return EXIT_FAILURE;
+        if (!componentsFilename.empty() && !processor->SaveComponents(componentsFilename, connectivity)) return EXIT_FAILURE;
+    }
     
     std::cout << "File (" << outputFilename << ") saved \n";
 }
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DistanceKernels.hpp"
+
+enum class CentroidSearch { Auto, Brute, KdTree };
+
+// "auto", "brute" or "kdtree"
+bool ParseCentroidSearch(const std::string& name, CentroidSearch& search);
+const char* CentroidSearchName(CentroidSearch search);
+
+// Auto uses the k-d tree from TreeMinCentroids centroids on for 2 coordinates, twice as many for every further one,
+// up to TreeMaxDimensions coordinates (past that the tree prunes too little to beat the SIMD scan)
+constexpr int TreeMinCentroids = 128;
+constexpr int TreeMaxDimensions = 8;
+CentroidSearch ResolveCentroidSearch(CentroidSearch search, int centroids, int dimensions);
+
+// k-d tree over the centroids, rebuilt after every update (O(K log K)) and then queried concurrently.
+// Nodes split at the median of their widest coordinate until LeafSize centroids are left,
+// distances are summed like the distance kernels so the tree finds exactly the centroid the scan finds.
+class CentroidTree
+{
+    public:
+        static constexpr int LeafSize = 8;
+
+        void Build(const CentroidSet& centroids);
+
+        // Nearest centroid (lowest index on ties) and its squared distance; with `second` also the squared distance
+        // to the second nearest. Adds the centroid distances computed to `evaluated`
+        int Nearest(const double* point, double& distance, double* second, uint64_t& evaluated) const;
+
+    private:
+        struct Node {
+            int Begin;
+            int End;
+            int Dimension;
+            double Split;
+            // -1 for leaves
+            int Left;
+            int Right;
+        };
+
+        int BuildNode(int begin, int end, const CentroidSet& centroids);
+
+        int _dimensions = 0;
+        std::vector<Node> _nodes;
+        // centroid indices in tree order, their coordinates point by point in the same order
+        std::vector<int> _ids;
+        std::vector<double> _coordinates;
+};
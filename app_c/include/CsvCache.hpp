@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <MappedFile.hpp>
+
+#include "CsvReader.hpp"
+
+class ThreadPool;
+
+// Size and modification time of the source CSV, what a cache is checked against
+struct CsvFileStamp {
+    uint64_t Size = 0;
+    int64_t Time = 0;
+
+    // false when the file can't be stat'ed
+    bool Read(const std::string& filename);
+};
+
+// Binary columnar copy of a parsed CSV kept next to it as <file>.cache: the header, the type of every column
+// and the values and valid flags of the numeric ones, laid out so the mapping is used in place.
+class CsvCache
+{
+    public:
+        static std::string PathFor(const std::string& csvFilename);
+
+        // Writes table as the cache of csvFilename through a temporary file renamed at the end,
+        // stamp is taken before the CSV was parsed. False (and a message on stderr) when it can't be written.
+        static bool Save(const std::string& csvFilename, const CsvFileStamp& stamp, const CsvTable& table);
+
+        // Maps the cache of csvFilename, false when there is none, it is damaged
+        // or the CSV size or modification time changed since it was written
+        bool Open(const std::string& csvFilename);
+        void Close();
+
+        size_t GetRowCount() const { return _rowCount; }
+        const std::vector<std::string>& GetHeader() const { return _header; }
+
+        // same as ViewCsvColumns, the views point into the mapping and stay valid until Close
+        bool View(const std::vector<std::string>& names, std::vector<CsvColumnView>& views, std::vector<int>& ids) const;
+
+    private:
+        MappedFile _file;
+        size_t _rowCount = 0;
+        std::vector<std::string> _header;
+        std::vector<CsvColumnView> _columns;
+};
+
+// The requested columns from the cache of filename when it is fresh, otherwise every column is parsed
+// (ReadCsvTable), the cache is (re)written and the columns are selected from the parsed table.
+// useCache = false parses only the requested columns (ReadCsvColumns) and leaves the cache alone.
+bool ReadCsvColumnsCached(const std::string& filename, const std::vector<std::string>& columns, CsvColumns& result,
+                          ThreadPool& pool, bool useCache, bool& fromCache);
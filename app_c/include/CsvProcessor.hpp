@@ -2,86 +2,139 @@
 
 #include <string>
 #include <vector>
-#include <map>
-#include <thread>
 #include <chrono>
-#include <cmath>
-#include <atomic>
+#include <cstdint>
+#include <utility>
 
-struct GraphInfo {
-    std::string LabelX = "None";
-    std::string LabelY = "None";
-    int XId = -1;
-    int YId = -1;
-};
+#include "CentroidTree.hpp"
+#include "DistanceKernels.hpp"
+#include "KMeansAssignment.hpp"
+#include "KMeansSeeding.hpp"
+#include "PointSet.hpp"
+#include "Silhouette.hpp"
 
-struct Point {
-    double X, Y;     // coordinates
-    int ClusterId;     // no default cluster
-    
-    Point() : 
-        X(0.0), 
-        Y(0.0),
-        ClusterId(-1) {}
-        
-    Point(double x, double y) : 
-        X(x), 
-        Y(y),
-        ClusterId(-1) {}
+class ThreadPool;
 
-    double Distance(Point p) {
-        return sqrt((p.X - X) * (p.X - X) + (p.Y - Y) * (p.Y - Y));
-    }
+struct GraphInfo {
+    // clustered columns and their index in the CSV header
+    std::vector<std::string> Labels;
+    std::vector<int> Ids;
 };
 
 struct Cluster {
     int Id;
-    Point Centroid;
-    std::vector<Point> Points;
+    // one coordinate per clustered column
+    std::vector<double> Centroid;
+    // indices of the member points in GetPoints()
+    std::vector<uint32_t> Points;
 
-    Cluster(int clusterId, Point centroid) :
+    Cluster(int clusterId, std::vector<double> centroid) :
         Id(clusterId),
-        Centroid(centroid) {}
+        Centroid(std::move(centroid)) {}
+};
+
+struct ClusteringOptions {
+    // how the initial centroids are picked, see SeedCentroids
+    SeedingMethod Seeding = SeedingMethod::KMeansPlusPlus;
+    uint64_t Seed = 1;
+    // Lloyd scans every centroid for every point, Hamerly and Elkan skip what their distance bounds rule out
+    AssignmentMethod Assignment = AssignmentMethod::Lloyd;
+    // how Lloyd and Hamerly find the nearest centroid: SIMD scan, k-d tree, or the tree for large K and few dimensions
+    CentroidSearch Search = CentroidSearch::Auto;
+    // Lloyd iterations at most
+    uint32_t MaxIterations = 100;
+    // converged once no centroid moves farther than this between two iterations (columns are scaled to [0, 1])
+    double Tolerance = 1e-4;
+    // how the clustering is scored once it stopped; Sampled scores SilhouetteSamples points drawn with Seed
+    SilhouetteMethod Silhouette = SilhouetteMethod::Auto;
+    size_t SilhouetteSamples = 1000;
+};
+
+// What one k-means iteration did
+struct IterationStats {
+    uint32_t Iteration;
+    double Milliseconds;
+    // sum of squared distances of the points to the updated centroid of their cluster
+    double Inertia;
+    // points whose cluster changed (every point in the first iteration)
+    uint64_t Reassigned;
+    // point to centroid distances computed by the assignment
+    uint64_t Distances;
+    // farthest centroid move of the update
+    double MaxShift;
 };
 
 class CsvProcessor
 {
     public:
-        CsvProcessor(const std::string& filename, const std::string& columnXName, const std::string& columnYName, uint64_t maxVectorCount = 5000);
+        // Clusters the points made of the named columns, the first maxVectorCount rows of the file (0 for all of them) (any count, 2, 3, 4, 8 and 16 have unrolled distance kernels).
+        // The file is parsed over threadCount threads; with useCache the columns come from the binary cache
+        // next to the file when it is fresh, otherwise the cache is written after the parse (see CsvCache)
+        CsvProcessor(const std::string& filename, const std::vector<std::string>& columns, uint64_t maxVectorCount = 0,
+                     uint8_t threadCount = 1, bool useCache = true);
         ~CsvProcessor() = default;
         bool GetIsReady() { return _ready; }
-        void PerformClusterization(uint32_t K, uint8_t threadCount = 1);
+        // Lloyd iterations until the centroids move less than options.Tolerance, no point changes cluster
+        // or options.MaxIterations is reached, then scores the clusters with options.Silhouette.
+        // False when K is 0 or larger than the point count
+        bool PerformClusterization(uint32_t K, uint8_t threadCount = 1, const ClusteringOptions& options = ClusteringOptions());
+        const std::vector<IterationStats>& GetIterationStats() const { return _iterationStats; }
+        const SilhouetteResult& GetSilhouette() const { return _silhouette; }
+        // iteration,ms,inertia,reassigned,distances,max_shift
+        bool SaveIterationStats(const std::string& filename) const;
         std::vector<Cluster> GetCluseters() { return _clusters; }
+        // every column divided by its maximum
+        const PointSet& GetPoints() const { return _points; }
+        const GraphInfo& GetGraphInfo() const { return _graphInfo; }
 
     private:
-        void ReadFileAndNormalize(const std::string& filename, std::vector<Point>& points, GraphInfo& info);
+        void ReadFileAndNormalize(const std::string& filename, PointSet& points, GraphInfo& info, ThreadPool& pool);
         void CutToVectorCount(uint64_t vectorCount);
-        void ClampToOne(std::vector<Point>& points, double maxX, double maxY);
+        void ClampToOne(PointSet& points, const std::vector<double>& maxima, ThreadPool& pool);
 
-        void CalculateDissimalarityAndSimilarity(uint32_t start, uint32_t end, uint32_t K, int pointsCount);
-        double CalculateSilhouette(uint32_t K, int pointsCount, uint8_t threadCount);
-        
-        void CalculateNearestClusterForDots(uint32_t start, uint32_t end);
-        int GetNearestClusterId(Point& point);
+        // sizes the per block sums for K clusters
+        void PrepareCentroidSums(uint32_t K);
+        // assigns the points of one block to their nearest centroid and sums them per cluster
+        void AssignAndSumBlock(size_t block);
+        // block sums -> cluster sizes and centroids, returns the farthest centroid move
+        double RecalculateClusterCentroids(ThreadPool& pool);
+        // Cluster::Points from the final assignments
+        void CollectClusterPoints();
+        // cluster centroids -> the dimension major copy the distance kernels read, and the tree when it is used
+        void UpdateCentroidSet();
 
-        void ClearClusterPoints();
-        void RecalculateClusterCentroids(uint32_t clusterId, uint32_t K, uint32_t pointsCount);
-        
     private:
-        // std::atomic_bool _clusterizationDone = true;
         bool _ready = false;
-        // threading and time
-        std::vector<std::thread> _threads;
+        bool _useCache = true;
+        // time
         std::chrono::steady_clock::time_point _tsBegin;
         std::chrono::steady_clock::time_point _tsEnd;
 
         // csv data
-        // std::vector
-        std::vector<Point> _points;
+        PointSet _points;
+        // cluster index of every point, -1 before the first assignment
+        std::vector<int> _assignments;
         std::vector<Cluster> _clusters;
+        // per block and cluster coordinate sums (block, cluster, dimension) and point counts (block, cluster)
+        static constexpr size_t SumBlockPoints = 16384;
+        static constexpr size_t MaxSumValues = size_t(1) << 22;
+        size_t _blockSize = SumBlockPoints;
+        std::vector<double> _blockSums;
+        std::vector<uint64_t> _blockCounts;
+        // per block and cluster sums of squared point norms, per block reassigned points and computed distances
+        std::vector<double> _blockSquares;
+        std::vector<uint64_t> _blockReassigned;
+        std::vector<uint64_t> _blockDistances;
+        std::vector<uint64_t> _clusterSizes;
+        std::vector<double> _clusterInertia;
+        std::vector<double> _centroidShifts;
+        std::vector<IterationStats> _iterationStats;
+        SilhouetteResult _silhouette;
+        CentroidSet _centroids;
+        DistanceKernels _kernels;
+        AssignmentMethod _assignment = AssignmentMethod::Lloyd;
+        BoundedAssignment _bounds;
+        CentroidSearch _search = CentroidSearch::Brute;
+        CentroidTree _tree;
         GraphInfo _graphInfo;
-
-        std::vector<double> a;
-        std::vector<double> b;
-
-};
\ No newline at end of file
+};
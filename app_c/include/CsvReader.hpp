@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Requested numeric columns of a CSV file, the other columns are only skipped over
+struct CsvColumns {
+    // every column name of the header line
+    std::vector<std::string> Header;
+    // header index of every requested column
+    std::vector<int> Ids;
+    // one vector per requested column, holding the rows where every requested field is a number
+    std::vector<std::vector<double>> Values;
+    // data lines left out because a requested field is missing or not a number
+    size_t SkippedRows = 0;
+
+    size_t GetRowCount() const { return Values.empty() ? 0 : Values[0].size(); }
+};
+
+// Maps the file and parses it in chunks of whole lines over `pool`: fields are split on ',',
+// only the requested ones are converted (std::from_chars, surrounding blanks and '\r' ignored).
+// Rows keep their file order. False (and a message on stdout) when the file can't be read or a column is missing.
+bool ReadCsvColumns(const std::string& filename, const std::vector<std::string>& columns, CsvColumns& result, ThreadPool& pool);
+
+// Every column of a CSV file: one value and one valid flag per data line (blank lines are not rows).
+// A column without a single number is text and keeps no values.
+struct CsvTable {
+    std::vector<std::string> Header;
+    // per header column, empty for text columns; values are 0 where the field is not a number
+    std::vector<std::vector<double>> Values;
+    std::vector<std::vector<uint8_t>> Valid;
+    size_t RowCount = 0;
+
+    bool IsNumeric(size_t column) const { return !Values[column].empty(); }
+};
+
+// Same chunked parse as ReadCsvColumns, converting every field
+bool ReadCsvTable(const std::string& filename, CsvTable& table, ThreadPool& pool);
+
+// One numeric column of a table or of a mapped cache
+struct CsvColumnView {
+    const double* Values;
+    const uint8_t* Valid;
+};
+
+// The rows of `rowCount` where every column is valid, as CsvColumns (Header and Ids are left to the caller)
+void SelectCsvRows(const std::vector<CsvColumnView>& columns, size_t rowCount, CsvColumns& result, ThreadPool& pool);
+
+// Views of the named columns of table, a text column selects no rows.
+// False (and a message on stdout) when a name is not in the header.
+bool ViewCsvColumns(const CsvTable& table, const std::vector<std::string>& names, std::vector<CsvColumnView>& views, std::vector<int>& ids);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <CpuFeatures.hpp>
+
+// Centroids stored dimension by dimension: coordinate d of centroid k is Row(d)[k].
+// Rows are padded to a multiple of Lanes with +infinity, so a padding lane is never the nearest.
+class CentroidSet
+{
+    public:
+        // centroids compared at once by the distance kernels
+        static constexpr int Lanes = 4;
+
+        // coordinates are zeroed
+        void Resize(int count, int dimensions);
+
+        int GetCount() const { return _count; }
+        int GetDimensions() const { return _dimensions; }
+        size_t GetStride() const { return _stride; }
+
+        double* Row(int dimension) { return _values.data() + dimension * _stride; }
+        const double* Row(int dimension) const { return _values.data() + dimension * _stride; }
+
+        double Get(int centroid, int dimension) const { return _values[dimension * _stride + centroid]; }
+        void Set(int centroid, int dimension, double value) { _values[dimension * _stride + centroid] = value; }
+
+    private:
+        int _count = 0;
+        int _dimensions = 0;
+        size_t _stride = 0;
+        std::vector<double> _values;
+};
+
+// Index of the centroid nearest to point (GetDimensions() coordinates), ties go to the lower index;
+// the squared distance to it is stored in `distance`
+using NearestCentroidFunction = int (*)(const double* point, const CentroidSet& centroids, double& distance);
+
+// Squared distance from point to every centroid into distances[0, GetStride()), the padding lanes get +infinity
+using CentroidDistancesFunction = void (*)(const double* point, const CentroidSet& centroids, double* distances);
+
+// Sum of the (not squared) distances from point to `count` points stored column by column:
+// coordinate d of point j is columns[d * stride + j]
+using DistanceSumFunction = double (*)(const double* point, const double* columns, size_t stride, int dimensions, size_t count);
+
+struct DistanceKernels {
+    SimdLevel Level;
+    NearestCentroidFunction Nearest;
+    CentroidDistancesFunction Distances;
+    DistanceSumFunction DistanceSum;
+};
+
+// Kernels of the best instruction set of the running CPU (see GetSimdLevel) for `dimensions` coordinates:
+// 2, 3, 4, 8 and 16 dimensions have their own unrolled versions. Every level gives the same results.
+DistanceKernels GetDistanceKernels(int dimensions);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CentroidTree.hpp"
+#include "DistanceKernels.hpp"
+
+class ThreadPool;
+
+enum class AssignmentMethod { Lloyd, Hamerly, Elkan };
+
+// "lloyd", "hamerly" or "elkan"
+bool ParseAssignmentMethod(const std::string& name, AssignmentMethod& method);
+const char* AssignmentMethodName(AssignmentMethod method);
+
+// Distance bounds kept per point across k-means iterations, so the nearest centroid search is skipped
+// while the triangle inequality proves the assigned centroid is still the nearest.
+// Hamerly keeps an upper bound to the assigned centroid and one lower bound to all the others,
+// Elkan a lower bound per centroid (points x K values) and the centroid to centroid distances.
+// Both find the same nearest centroids as the Lloyd scan (up to exact ties).
+class BoundedAssignment
+{
+    public:
+        // Elkan falls back to Hamerly when its bounds would take more memory than this
+        static constexpr size_t ElkanMaxBytes = size_t(512) << 20;
+
+        // Sizes the bounds for pointCount points and K centroids, the first Assign of every point is a full scan.
+        // Returns the method actually used
+        AssignmentMethod Reset(AssignmentMethod method, size_t pointCount, int K);
+
+        // To call after the centroids moved, `shifts` holding how far each one did (not squared):
+        // loosens the bounds and recomputes the centroid to centroid distances
+        void Update(const CentroidSet& centroids, const std::vector<double>& shifts, ThreadPool& pool);
+
+        // Nearest centroid of point `index` (its coordinates in point), `current` being its cluster so far.
+        // Hamerly searches `tree` instead of scanning every centroid when it is given (Elkan needs every distance).
+        // Safe to call concurrently for different points; adds the distances it computed to `evaluated`
+        int Assign(size_t index, const double* point, int current, const CentroidSet& centroids,
+                   const DistanceKernels& kernels, const CentroidTree* tree, uint64_t& evaluated);
+
+    private:
+        int FullScan(size_t index, const double* point, const CentroidSet& centroids, const DistanceKernels& kernels);
+        int TreeSearch(size_t index, const double* point, const CentroidTree& tree, uint64_t& evaluated);
+        int AssignHamerly(size_t index, const double* point, int current, const CentroidSet& centroids,
+                          const DistanceKernels& kernels, const CentroidTree* tree, uint64_t& evaluated);
+        int AssignElkan(size_t index, const double* point, int current, const CentroidSet& centroids, uint64_t& evaluated);
+
+        AssignmentMethod _method = AssignmentMethod::Hamerly;
+        int _K = 0;
+        // no bound is valid before the first Update
+        bool _fresh = true;
+
+        std::vector<double> _upper;
+        // Hamerly: one per point, Elkan: K per point
+        std::vector<double> _lower;
+
+        // how far every centroid moved in the last update, the largest and second largest move
+        std::vector<double> _shifts;
+        double _maxShift = 0.0;
+        double _secondShift = 0.0;
+        int _maxShiftCentroid = 0;
+
+        // half the distance of every centroid to its nearest other centroid
+        std::vector<double> _halfNearest;
+        // Elkan: half the distance between every pair of centroids, K x K
+        std::vector<double> _halfDistances;
+};
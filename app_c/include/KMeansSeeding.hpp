@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DistanceKernels.hpp"
+#include "PointSet.hpp"
+
+class ThreadPool;
+
+enum class SeedingMethod { Random, KMeansPlusPlus, KMeansParallel };
+
+// "random", "kmeans++" or "kmeans||"
+bool ParseSeedingMethod(const std::string& name, SeedingMethod& method);
+const char* SeedingMethodName(SeedingMethod method);
+
+// Indices of K distinct points to start the centroids from, K must not exceed the point count.
+// Random: uniform draws.
+// k-means++: each next point is drawn with a probability proportional to its squared distance to the nearest one drawn so far.
+// k-means||: a few rounds each sample about 2K candidates the same way, independently per point,
+// then a k-means++ pass over the candidates, weighted by how many points each one is nearest to, keeps K of them.
+// It needs 5 passes over the points instead of K but computes about 10 times the distances of k-means++,
+// so it only pays off for large K when the passes, not the distances, are the bottleneck.
+// Distances are updated in parallel over fixed blocks of points with one random stream per block derived from `seed`,
+// so a seed picks the same points for any thread count.
+std::vector<uint32_t> SeedCentroids(const PointSet& points, uint32_t K, SeedingMethod method, uint64_t seed,
+                                    const DistanceKernels& kernels, ThreadPool& pool);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Points stored as structure of arrays: coordinate d of point i is Column(d)[i].
+// Every column holds GetCount() values, columns are GetStride() values apart.
+class PointSet
+{
+    public:
+        // coordinates are zeroed, storage is reused when it is large enough
+        void Resize(size_t count, int dimensions);
+        // keeps the first `count` points, the columns stay where they are
+        void Truncate(size_t count);
+
+        size_t GetCount() const { return _count; }
+        int GetDimensions() const { return _dimensions; }
+        size_t GetStride() const { return _stride; }
+
+        double* Column(int dimension) { return _values.data() + dimension * _stride; }
+        const double* Column(int dimension) const { return _values.data() + dimension * _stride; }
+
+        double At(size_t point, int dimension) const { return _values[dimension * _stride + point]; }
+
+        // the coordinates of one point into dst[0, dimensions)
+        void Gather(size_t point, double* dst) const
+        {
+            for (int d = 0; d < _dimensions; d++) dst[d] = _values[d * _stride + point];
+        }
+
+    private:
+        size_t _count = 0;
+        size_t _stride = 0;
+        int _dimensions = 0;
+        std::vector<double> _values;
+};
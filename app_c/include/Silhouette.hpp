@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DistanceKernels.hpp"
+#include "PointSet.hpp"
+
+class ThreadPool;
+
+enum class SilhouetteMethod { Auto, Exact, Simplified, Sampled, None };
+
+// "auto", "exact", "simplified", "sampled" or "none"
+bool ParseSilhouetteMethod(const std::string& name, SilhouetteMethod& method);
+const char* SilhouetteMethodName(SilhouetteMethod method);
+
+// Auto is exact up to this many points and sampled above
+constexpr size_t ExactSilhouetteMaxPoints = 20000;
+
+struct SilhouetteResult {
+    // the method that ran, Auto resolved
+    SilhouetteMethod Method = SilhouetteMethod::None;
+    // false when fewer than two clusters have points, the index is not defined then
+    bool Valid = false;
+    double Value = 0.0;
+    // Sampled: points scored and half the width of the 95% confidence interval around Value
+    size_t Samples = 0;
+    double Margin = 0.0;
+};
+
+// Mean silhouette (b - a) / max(a, b) of the clustering given by `assignments` (cluster index per point, K clusters):
+// Exact: a is the mean distance to the other points of the cluster, b the lowest mean distance to another cluster,
+//        all N^2 distances summed in tiles of a cluster sorted copy with the DistanceSum kernel.
+// Simplified: a and b are the distances to the own and the nearest other centroid, O(N K).
+// Sampled: the exact value of `samples` points drawn without replacement with `seed`, O(samples N).
+// Points with a cluster of their own score 0. The result doesn't depend on the thread count.
+SilhouetteResult ComputeSilhouette(const PointSet& points, const std::vector<int>& assignments, const CentroidSet& centroids,
+                                   SilhouetteMethod method, size_t samples, uint64_t seed,
+                                   const DistanceKernels& kernels, ThreadPool& pool);
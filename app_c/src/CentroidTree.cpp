@@ -0,0 +1,161 @@
+#include "CentroidTree.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+    // deep enough for any tree built from an int count of centroids
+    constexpr int MaxStack = 64;
+}
+
+bool ParseCentroidSearch(const std::string& name, CentroidSearch& search)
+{
+    if (name == "auto") search = CentroidSearch::Auto;
+    else if (name == "brute") search = CentroidSearch::Brute;
+    else if (name == "kdtree") search = CentroidSearch::KdTree;
+    else return false;
+    return true;
+}
+
+const char* CentroidSearchName(CentroidSearch search)
+{
+    switch (search)
+    {
+        case CentroidSearch::Auto: return "auto";
+        case CentroidSearch::Brute: return "brute";
+        case CentroidSearch::KdTree: return "kdtree";
+    }
+    return "unknown";
+}
+
+CentroidSearch ResolveCentroidSearch(CentroidSearch search, int centroids, int dimensions)
+{
+    if (search != CentroidSearch::Auto) return search;
+    if (dimensions > TreeMaxDimensions) return CentroidSearch::Brute;
+
+    const int64_t minCentroids = dimensions < 2 ? TreeMinCentroids / 2 : (int64_t)TreeMinCentroids << (dimensions - 2);
+    return centroids >= minCentroids ? CentroidSearch::KdTree : CentroidSearch::Brute;
+}
+
+void CentroidTree::Build(const CentroidSet& centroids)
+{
+    const int count = centroids.GetCount();
+    _dimensions = centroids.GetDimensions();
+    _nodes.clear();
+    _ids.resize(count);
+    std::iota(_ids.begin(), _ids.end(), 0);
+
+    if (count > 0) BuildNode(0, count, centroids);
+
+    _coordinates.resize((size_t)count * _dimensions);
+    for (int i = 0; i < count; i++)
+    {
+        for (int d = 0; d < _dimensions; d++) _coordinates[(size_t)i * _dimensions + d] = centroids.Get(_ids[i], d);
+    }
+}
+
+int CentroidTree::BuildNode(int begin, int end, const CentroidSet& centroids)
+{
+    const int index = (int)_nodes.size();
+    _nodes.push_back({ begin, end, 0, 0.0, -1, -1 });
+    if (end - begin <= LeafSize) return index;
+
+    int widest = 0;
+    double widestSpread = -1.0;
+    for (int d = 0; d < _dimensions; d++)
+    {
+        auto range = std::minmax_element(_ids.begin() + begin, _ids.begin() + end,
+            [&](int lhs, int rhs) { return centroids.Get(lhs, d) < centroids.Get(rhs, d); });
+        double spread = centroids.Get(*range.second, d) - centroids.Get(*range.first, d);
+        if (spread > widestSpread)
+        {
+            widestSpread = spread;
+            widest = d;
+        }
+    }
+
+    // left holds coordinates <= Split, right >= Split
+    const int middle = begin + (end - begin) / 2;
+    std::nth_element(_ids.begin() + begin, _ids.begin() + middle, _ids.begin() + end,
+        [&](int lhs, int rhs) { return centroids.Get(lhs, widest) < centroids.Get(rhs, widest); });
+
+    const double split = centroids.Get(_ids[middle], widest);
+    int left = BuildNode(begin, middle, centroids);
+    int right = BuildNode(middle, end, centroids);
+
+    Node& node = _nodes[index];
+    node.Dimension = widest;
+    node.Split = split;
+    node.Left = left;
+    node.Right = right;
+    return index;
+}
+
+int CentroidTree::Nearest(const double* point, double& distance, double* second, uint64_t& evaluated) const
+{
+    double best = std::numeric_limits<double>::infinity();
+    double secondBest = std::numeric_limits<double>::infinity();
+    int nearest = 0;
+    if (_nodes.empty())
+    {
+        distance = best;
+        if (second) *second = secondBest;
+        return nearest;
+    }
+
+    // nodes still to visit with a lower bound of the squared distance to anything inside
+    struct Pending {
+        int Node;
+        double Bound;
+    };
+    Pending stack[MaxStack];
+    int depth = 0;
+    stack[depth++] = { 0, 0.0 };
+
+    while (depth > 0)
+    {
+        const Pending pending = stack[--depth];
+        // strictly farther only, so a tie with a lower index is still found
+        if (pending.Bound > (second ? secondBest : best)) continue;
+
+        const Node& node = _nodes[pending.Node];
+        if (node.Left < 0)
+        {
+            for (int i = node.Begin; i < node.End; i++)
+            {
+                const double* centroid = _coordinates.data() + (size_t)i * _dimensions;
+                double sum = 0.0;
+                for (int d = 0; d < _dimensions; d++)
+                {
+                    double diff = centroid[d] - point[d];
+                    sum += diff * diff;
+                }
+                evaluated++;
+
+                const int id = _ids[i];
+                if (sum < best || (sum == best && id < nearest))
+                {
+                    // the replaced nearest becomes the runner-up
+                    secondBest = std::min(secondBest, best);
+                    best = sum;
+                    nearest = id;
+                }
+                else if (sum < secondBest) secondBest = sum;
+            }
+            continue;
+        }
+
+        const double diff = point[node.Dimension] - node.Split;
+        const int nearChild = diff < 0.0 ? node.Left : node.Right;
+        const int farChild = diff < 0.0 ? node.Right : node.Left;
+        // far side first so the near side is visited first
+        stack[depth++] = { farChild, std::max(pending.Bound, diff * diff) };
+        stack[depth++] = { nearChild, pending.Bound };
+    }
+
+    distance = best;
+    if (second) *second = secondBest;
+    return nearest;
+}
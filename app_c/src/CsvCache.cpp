@@ -0,0 +1,249 @@
+#include "CsvCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#include <ThreadPool.hpp>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // bumped whenever the layout below changes, older caches are then rebuilt
+    constexpr char Magic[8] = { 'C', 'S', 'V', 'C', 'A', 'C', 'H', 'E' };
+    constexpr uint32_t Version = 1;
+    constexpr uint32_t TextColumn = 0;
+    constexpr uint32_t NumericColumn = 1;
+
+    // File layout, native byte order (the byte order mark rejects caches from another one):
+    // CacheHeader, ColumnCount ColumnEntry, the names, then per numeric column its values and its valid flags,
+    // every section starting on 8 bytes
+    struct CacheHeader {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t ByteOrderMark;
+        uint64_t ColumnCount;
+        uint64_t RowCount;
+        uint64_t SourceSize;
+        int64_t SourceTime;
+    };
+
+    struct ColumnEntry {
+        uint64_t NameOffset;
+        uint32_t NameLength;
+        uint32_t Type;
+        uint64_t ValuesOffset;
+        uint64_t ValidOffset;
+    };
+
+    constexpr uint32_t ByteOrderMark = 0x01020304;
+
+    size_t Align8(size_t offset)
+    {
+        return (offset + 7) & ~size_t(7);
+    }
+
+    // true when [offset, offset + size) lies inside a file of fileSize bytes
+    bool Fits(uint64_t offset, uint64_t size, uint64_t fileSize)
+    {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+}
+
+bool CsvFileStamp::Read(const std::string& filename)
+{
+    std::error_code error;
+    uintmax_t size = fs::file_size(filename, error);
+    if (error) return false;
+    fs::file_time_type time = fs::last_write_time(filename, error);
+    if (error) return false;
+
+    Size = (uint64_t)size;
+    Time = (int64_t)time.time_since_epoch().count();
+    return true;
+}
+
+std::string CsvCache::PathFor(const std::string& csvFilename)
+{
+    return csvFilename + ".cache";
+}
+
+bool CsvCache::Save(const std::string& csvFilename, const CsvFileStamp& stamp, const CsvTable& table)
+{
+    const size_t columnCount = table.Header.size();
+    const size_t rows = table.RowCount;
+
+    std::vector<ColumnEntry> entries(columnCount);
+    size_t offset = sizeof(CacheHeader) + columnCount * sizeof(ColumnEntry);
+    for (size_t c = 0; c < columnCount; c++)
+    {
+        entries[c].NameOffset = offset;
+        entries[c].NameLength = (uint32_t)table.Header[c].size();
+        offset += table.Header[c].size();
+    }
+    for (size_t c = 0; c < columnCount; c++)
+    {
+        entries[c].Type = table.IsNumeric(c) ? NumericColumn : TextColumn;
+        entries[c].ValuesOffset = entries[c].ValidOffset = 0;
+        if (!table.IsNumeric(c)) continue;
+
+        entries[c].ValuesOffset = offset = Align8(offset);
+        offset += rows * sizeof(double);
+        entries[c].ValidOffset = offset;
+        offset += rows;
+    }
+    const size_t fileSize = Align8(offset);
+
+    const std::string path = PathFor(csvFilename);
+    const std::string temporary = path + ".tmp";
+    MappedFile file;
+    if (!file.Create(temporary, fileSize))
+    {
+        std::cerr << "Couldn't write cache: " << path << "\n";
+        return false;
+    }
+
+    uint8_t* data = file.MutableData();
+    CacheHeader header{};
+    std::memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = Version;
+    header.ByteOrderMark = ByteOrderMark;
+    header.ColumnCount = columnCount;
+    header.RowCount = rows;
+    header.SourceSize = stamp.Size;
+    header.SourceTime = stamp.Time;
+    std::memcpy(data, &header, sizeof(header));
+    std::memcpy(data + sizeof(header), entries.data(), columnCount * sizeof(ColumnEntry));
+
+    for (size_t c = 0; c < columnCount; c++)
+    {
+        std::memcpy(data + entries[c].NameOffset, table.Header[c].data(), entries[c].NameLength);
+        if (!table.IsNumeric(c)) continue;
+        std::memcpy(data + entries[c].ValuesOffset, table.Values[c].data(), rows * sizeof(double));
+        std::memcpy(data + entries[c].ValidOffset, table.Valid[c].data(), rows);
+    }
+    file.Close();
+
+    std::error_code error;
+    fs::rename(temporary, path, error);
+    if (error)
+    {
+        fs::remove(temporary, error);
+        std::cerr << "Couldn't write cache: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool CsvCache::Open(const std::string& csvFilename)
+{
+    Close();
+
+    CsvFileStamp stamp;
+    if (!stamp.Read(csvFilename) || !_file.OpenRead(PathFor(csvFilename))) return false;
+
+    const uint8_t* data = _file.Data();
+    const uint64_t fileSize = _file.Size();
+
+    CacheHeader header;
+    bool valid = fileSize >= sizeof(header);
+    if (valid)
+    {
+        std::memcpy(&header, data, sizeof(header));
+        valid = std::memcmp(header.Magic, Magic, sizeof(Magic)) == 0 && header.Version == Version &&
+            header.ByteOrderMark == ByteOrderMark && header.SourceSize == stamp.Size && header.SourceTime == stamp.Time &&
+            header.ColumnCount <= fileSize / sizeof(ColumnEntry) && Fits(sizeof(header), header.ColumnCount * sizeof(ColumnEntry), fileSize) &&
+            header.RowCount <= fileSize;
+    }
+
+    const ColumnEntry* entries = valid ? reinterpret_cast<const ColumnEntry*>(data + sizeof(header)) : nullptr;
+    for (uint64_t c = 0; valid && c < header.ColumnCount; c++)
+    {
+        const ColumnEntry& entry = entries[c];
+        valid = Fits(entry.NameOffset, entry.NameLength, fileSize);
+        if (valid && entry.Type == NumericColumn)
+        {
+            valid = entry.ValuesOffset % 8 == 0 && Fits(entry.ValuesOffset, header.RowCount * sizeof(double), fileSize) &&
+                Fits(entry.ValidOffset, header.RowCount, fileSize);
+        }
+        else if (valid) valid = entry.Type == TextColumn;
+        if (!valid) break;
+
+        _header.emplace_back(reinterpret_cast<const char*>(data + entry.NameOffset), entry.NameLength);
+        _columns.push_back(entry.Type == NumericColumn
+            ? CsvColumnView{ reinterpret_cast<const double*>(data + entry.ValuesOffset), data + entry.ValidOffset }
+            : CsvColumnView{ nullptr, nullptr });
+    }
+
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+
+    _rowCount = header.RowCount;
+    return true;
+}
+
+void CsvCache::Close()
+{
+    _file.Close();
+    _rowCount = 0;
+    _header.clear();
+    _columns.clear();
+}
+
+bool CsvCache::View(const std::vector<std::string>& names, std::vector<CsvColumnView>& views, std::vector<int>& ids) const
+{
+    views.clear();
+    ids.clear();
+    for (const std::string& name : names)
+    {
+        auto found = std::find(_header.begin(), _header.end(), name);
+        if (found == _header.end())
+        {
+            std::cout << "Column " << name << " was not found\n";
+            return false;
+        }
+
+        ids.push_back((int)(found - _header.begin()));
+        views.push_back(_columns[ids.back()]);
+    }
+    return true;
+}
+
+bool ReadCsvColumnsCached(const std::string& filename, const std::vector<std::string>& columns, CsvColumns& result,
+                          ThreadPool& pool, bool useCache, bool& fromCache)
+{
+    fromCache = false;
+    if (!useCache) return ReadCsvColumns(filename, columns, result, pool);
+
+    std::vector<CsvColumnView> views;
+    result = CsvColumns();
+
+    CsvCache cache;
+    if (cache.Open(filename))
+    {
+        if (!cache.View(columns, views, result.Ids)) return false;
+        result.Header = cache.GetHeader();
+        SelectCsvRows(views, cache.GetRowCount(), result, pool);
+        fromCache = true;
+        return true;
+    }
+
+    CsvFileStamp stamp;
+    bool stamped = stamp.Read(filename);
+
+    CsvTable table;
+    if (!ReadCsvTable(filename, table, pool)) return false;
+    // a cache that can't be written only costs the next run a parse
+    if (stamped) CsvCache::Save(filename, stamp, table);
+
+    if (!ViewCsvColumns(table, columns, views, result.Ids)) return false;
+    result.Header = table.Header;
+    SelectCsvRows(views, table.RowCount, result, pool);
+    return true;
+}
@@ -1,379 +1,378 @@
 #include "CsvProcessor.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <iomanip>
-#include <fstream>
-#include <sstream>
 #include "float.h"
 #include <numeric>
+#include <utility>
 
-bool is_number(const std::string& s)
-{
-    char* end = nullptr;
-    double val = strtod(s.c_str(), &end);
-    return end != s.c_str() && *end == '\0';
-}
+#include <ThreadPool.hpp>
 
-std::vector<std::string> split(std::string& s, std::string delimiter) {
-    size_t pos_start = 0, pos_end, delim_len = delimiter.length();
-    std::string token;
-    std::vector<std::string> res;
-
-    while ((pos_end = s.find(delimiter, pos_start)) != std::string::npos) {
-        token = s.substr (pos_start, pos_end - pos_start);
-        pos_start = pos_end + delim_len;
-        res.push_back (token);
-    }
+#include "CsvCache.hpp"
 
-    res.push_back (s.substr (pos_start));
-    return res;
-}
-
-CsvProcessor::CsvProcessor(const std::string& filename, const std::string& columnXName, const std::string& columnYName, uint64_t maxVectorCount)
+CsvProcessor::CsvProcessor(const std::string& filename, const std::vector<std::string>& columns, uint64_t maxVectorCount, uint8_t threadCount, bool useCache) :
+    _useCache(useCache)
 {
-    _graphInfo.LabelX = columnXName;
-    _graphInfo.LabelY = columnYName;
+    _graphInfo.Labels = columns;
 
-    std::cout << "Starting to parse file " << filename << " for columns " << columnXName << " and " << columnYName << std::endl;
+    std::cout << "Starting to parse file " << filename << " for columns";
+    for (const std::string& column : columns) std::cout << " " << column;
+    std::cout << std::endl;
 
-    ReadFileAndNormalize(filename, _points, _graphInfo);
+    ReadFileAndNormalize(filename, _points, _graphInfo, ThreadPool::Shared(threadCount));
     CutToVectorCount(maxVectorCount);
 }
 
-void CsvProcessor::ReadFileAndNormalize(const std::string& filename, std::vector<Point>& points, GraphInfo& info)
+void CsvProcessor::ReadFileAndNormalize(const std::string& filename, PointSet& points, GraphInfo& info, ThreadPool& pool)
 {
-    if (info.LabelX == "None" || info.LabelY == "None") 
+    if (info.Labels.empty() || std::find(info.Labels.begin(), info.Labels.end(), "None") != info.Labels.end())
     {
         std::cout << "Incorrect label info" << std::endl;
         return;
     }
 
-    static double maxX, maxY;
-    static bool initialized = false;
-    
-    std::ifstream input{filename};
+    auto tsBegin = std::chrono::steady_clock::now();
 
-    if (!input.is_open()) 
-    {
-        std::cerr << "Couldn't read file: " << filename << "\n";
-        return;
-    }
+    // rows where any of the columns is not a number are left out
+    CsvColumns columns;
+    bool fromCache = false;
+    if (!ReadCsvColumnsCached(filename, info.Labels, columns, pool, _useCache, fromCache)) return;
+
+    info.Ids = columns.Ids;
+
+    const int dimensions = (int)info.Labels.size();
+    const size_t count = columns.GetRowCount();
+    points.Resize(count, dimensions);
 
-    for (std::string line; std::getline(input, line);)
+    // the maxima start at 0 so negative columns are not flipped by ClampToOne
+    std::vector<double> maxima(dimensions);
+    for (int d = 0; d < dimensions; d++)
     {
-        // find needed columns ids
-        if (!initialized)
-        {
-            uint32_t columnId = 0;
-            for (std::string columnName : split(line, ","))
-            {
-                if (columnName == info.LabelX)
-                {
-                    info.XId = columnId;    
-                }
-                else if (columnName == info.LabelY)
+        const std::vector<double>& values = columns.Values[d];
+        double* column = points.Column(d);
+        maxima[d] = pool.ParallelReduce(0, count, 0.0,
+            [&](size_t start, size_t end) {
+                double partial = 0.0;
+                for (size_t i = start; i < end; i++)
                 {
-                    info.YId = columnId;    
+                    column[i] = values[i];
+                    partial = std::max(partial, values[i]);
                 }
-                columnId++;
-            }
-        }
-
-        if (info.XId == -1 || info.YId == -1) 
-        {
-            std::cout << "Labels were not found" << std::endl;
-            return;
-        }
-        
-        std::vector<std::string> tokens = split(line, ",");
-        if (!is_number(tokens[info.XId]) || !is_number(tokens[info.YId])) continue;
-        double x = std::stod(tokens[info.XId]);
-        double y = std::stod(tokens[info.YId]);
-        _points.push_back(
-            Point(x, y)
-        );
-
-        if (maxX < x) maxX = x;
-        if (maxY < y) maxY = y;
+                return partial;
+            },
+            [](double lhs, double rhs) { return std::max(lhs, rhs); });
+        std::vector<double>().swap(columns.Values[d]);
     }
 
-    ClampToOne(points, maxX, maxY);
+    ClampToOne(points, maxima, pool);
+
+    auto tsEnd = std::chrono::steady_clock::now();
+    std::cout << (fromCache ? "Loaded " : "Parsed ") << count << " rows (" << columns.SkippedRows << " skipped) " <<
+        (fromCache ? "from " + CsvCache::PathFor(filename) + " " : std::string()) << "in " <<
+        std::chrono::duration_cast<std::chrono::milliseconds>(tsEnd - tsBegin).count() << " ms" << std::endl;
 
     _ready = true;
 }
 
 void CsvProcessor::CutToVectorCount(uint64_t vectorCount)
 {
-    _points.resize(vectorCount);
+    if (vectorCount > 0) _points.Truncate(vectorCount);
 }
 
-double MeanDistanceToCluster(Point& point, Cluster& cluster)
+void CsvProcessor::PrepareCentroidSums(uint32_t K)
 {
-    double mean;
-    for (auto it = cluster.Points.begin(); it != cluster.Points.end(); it++)
-    {
-        mean += point.Distance(*it);
-    }
-
-    return mean / cluster.Points.size();
+    const size_t dimensions = _points.GetDimensions();
+    const size_t count = _points.GetCount();
+
+    // blocks are fixed by the point count (not by the thread count), their sums are added in block order,
+    // so the centroids don't depend on how many threads ran; large K gets larger blocks to bound the memory
+    _blockSize = std::max<size_t>(SumBlockPoints, count * K * (dimensions + 1) / MaxSumValues + 1);
+    const size_t blockCount = std::max<size_t>(1, (count + _blockSize - 1) / _blockSize);
+
+    _blockSums.assign(blockCount * K * dimensions, 0.0);
+    _blockCounts.assign(blockCount * K, 0);
+    _blockSquares.assign(blockCount * K, 0.0);
+    _blockReassigned.assign(blockCount, 0);
+    _blockDistances.assign(blockCount, 0);
+    _clusterSizes.assign(K, 0);
+    _clusterInertia.assign(K, 0.0);
+    _centroidShifts.assign(K, 0.0);
 }
 
-void CsvProcessor::CalculateDissimalarityAndSimilarity(uint32_t start, uint32_t end, uint32_t K, int pointsCount)
+void CsvProcessor::AssignAndSumBlock(size_t block)
 {
-    std::vector<double> temp;
-    temp.resize(K - 1);
-    for (int i = start; i < end; i++)
+    const int dimensions = _points.GetDimensions();
+    const size_t K = _clusterSizes.size();
+    const size_t start = block * _blockSize;
+    const size_t end = std::min(start + _blockSize, _points.GetCount());
+
+    double* sums = _blockSums.data() + block * K * dimensions;
+    uint64_t* counts = _blockCounts.data() + block * K;
+    double* squares = _blockSquares.data() + block * K;
+    std::fill(sums, sums + K * dimensions, 0.0);
+    std::fill(counts, counts + K, 0);
+    std::fill(squares, squares + K, 0.0);
+
+    // the kernels read a point as contiguous coordinates
+    static thread_local std::vector<double> point;
+    point.resize(dimensions);
+
+    uint64_t reassigned = 0;
+    uint64_t evaluated = 0;
+    for (size_t i = start; i < end; i++)
     {
-        int jindex = 0;
-        for (auto cluster = _clusters.begin(); cluster != _clusters.end(); cluster++)
+        _points.Gather(i, point.data());
+
+        int nearestClusterId;
+        const CentroidTree* tree = _search == CentroidSearch::KdTree ? &_tree : nullptr;
+        if (_assignment != AssignmentMethod::Lloyd)
         {
-            if (_points[i].ClusterId == cluster->Id)
-            {
-                a[i] = MeanDistanceToCluster(_points[i], *cluster);
-            }
-            else
-            {
-                temp[jindex++] = MeanDistanceToCluster(_points[i], *cluster);
-            }
+            nearestClusterId = _bounds.Assign(i, point.data(), _assignments[i], _centroids, _kernels, tree, evaluated);
         }
-
-        b[i] = *std::min_element(temp.begin(), temp.end());
-    }
-}
-
-double CsvProcessor::CalculateSilhouette(uint32_t K, int pointsCount, uint8_t threadCount)
-{
-    a.resize(pointsCount);
-    b.resize(pointsCount);
-
-    if (threadCount == 1)
-    {
-        CalculateDissimalarityAndSimilarity(0, pointsCount, K, pointsCount);
-    }
-    else
-    {
-        int step = pointsCount / threadCount;
-        for (int i = 0; i < threadCount; i++)
+        else if (tree)
         {
-            int start = i * step;
-            int end = (i + 1) * step + 1;
-            if (i == threadCount - 1) end = pointsCount;
-            _threads.push_back(std::thread(&CsvProcessor::CalculateDissimalarityAndSimilarity, this, start, end, K, pointsCount));
+            double distance;
+            nearestClusterId = tree->Nearest(point.data(), distance, nullptr, evaluated);
         }
-    
-        for (auto& thread : _threads)
+        else
         {
-            if (thread.joinable()) thread.join();
+            double distance;
+            nearestClusterId = _kernels.Nearest(point.data(), _centroids, distance);
+            evaluated += K;
         }
 
-        _threads.clear();
-    }
-   
-    
-    std::vector<double> s;
-    s.resize(pointsCount);
-    double maxim;
-    for (int i = 0; i < pointsCount; i++)
-    {
-        if (a[i] > b[i]) maxim = a[i];
-        else maxim = b[i];
+        if (_assignments[i] != nearestClusterId)
+        {
+            _assignments[i] = nearestClusterId;
+            reassigned++;
+        }
 
-        s[i] = (a[i] - b[i]) / maxim;
+        double* sum = sums + (size_t)nearestClusterId * dimensions;
+        double square = 0.0;
+        for (int d = 0; d < dimensions; d++)
+        {
+            sum[d] += point[d];
+            square += point[d] * point[d];
+        }
+        squares[nearestClusterId] += square;
+        counts[nearestClusterId]++;
     }
-
-    return std::accumulate(s.begin(), s.end(), 0.0) / pointsCount;
+    _blockReassigned[block] = reassigned;
+    _blockDistances[block] = evaluated;
 }
 
-int CsvProcessor::GetNearestClusterId(Point& point)
+double CsvProcessor::RecalculateClusterCentroids(ThreadPool& pool)
 {
-    if (_clusters.empty())
-    {
-        std::cerr << "Clusters empty" << std::endl;
-    }
+    const int dimensions = _points.GetDimensions();
+    const size_t K = _clusterSizes.size();
+    const size_t blockCount = _blockCounts.size() / K;
+
+    pool.ParallelFor(0, K, [&](size_t first, size_t last) {
+        static thread_local std::vector<double> sum;
+        sum.resize(dimensions);
+        for (size_t k = first; k < last; k++)
+        {
+            std::fill(sum.begin(), sum.end(), 0.0);
+            uint64_t size = 0;
+            double squares = 0.0;
+            for (size_t block = 0; block < blockCount; block++)
+            {
+                const double* blockSum = _blockSums.data() + (block * K + k) * dimensions;
+                for (int d = 0; d < dimensions; d++) sum[d] += blockSum[d];
+                size += _blockCounts[block * K + k];
+                squares += _blockSquares[block * K + k];
+            }
+            _clusterSizes[k] = size;
+            _clusterInertia[k] = 0.0;
+            _centroidShifts[k] = 0.0;
 
-    double minDist = DBL_MAX;
-    int nearestClusterId;
+            // an empty cluster keeps its centroid
+            if (size == 0) continue;
 
-    for (auto cluster = _clusters.begin(); cluster != _clusters.end(); cluster++)
-    {
-        double dist = point.Distance(cluster->Centroid);
-        if (dist < minDist) 
-        {
-            minDist = dist;
-            nearestClusterId = cluster->Id;
+            double shift = 0.0, centroidSquare = 0.0;
+            for (int d = 0; d < dimensions; d++)
+            {
+                double coordinate = sum[d] / size;
+                double diff = coordinate - _clusters[k].Centroid[d];
+                shift += diff * diff;
+                centroidSquare += coordinate * coordinate;
+                _clusters[k].Centroid[d] = coordinate;
+            }
+            _centroidShifts[k] = sqrt(shift);
+            // sum of |x - mean|^2 over the members = sum of |x|^2 - size * |mean|^2
+            _clusterInertia[k] = std::max(0.0, squares - size * centroidSquare);
         }
-    }
+    });
 
-    return nearestClusterId;
+    return *std::max_element(_centroidShifts.begin(), _centroidShifts.end());
 }
 
-void CsvProcessor::ClearClusterPoints()
+void CsvProcessor::CollectClusterPoints()
 {
-    for (Cluster& cluster : _clusters)
+    for (size_t k = 0; k < _clusters.size(); k++)
     {
-        cluster.Points.clear();
+        _clusters[k].Points.clear();
+        _clusters[k].Points.reserve(_clusterSizes[k]);
     }
-}
-
-void CsvProcessor::CalculateNearestClusterForDots(uint32_t start, uint32_t end)
-{
-    for (int i = start; i < end; i++)
+    for (uint32_t i = 0; i < _assignments.size(); i++)
     {
-        int currentClusterId = _points[i].ClusterId;
-        int nearestClusterId = GetNearestClusterId(_points[i]);
-
-        if (currentClusterId != nearestClusterId)
-        {
-            _points[i].ClusterId = nearestClusterId;
-            // _clusterizationDone = false;
-        }
+        _clusters[_assignments[i]].Points.push_back(i);
     }
 }
 
-void CsvProcessor::RecalculateClusterCentroids(uint32_t clusterId, uint32_t K, uint32_t pointsCount)
+void CsvProcessor::UpdateCentroidSet()
 {
-    // Recalculating the center of each cluster
-    for (int i = 0; i < K; i++)
+    for (size_t k = 0; k < _clusters.size(); k++)
     {
-        int clusterSize = _clusters[clusterId].Points.size();
-
-        if (clusterSize < 0) 
-        {
-            continue;
-        }
-        
-        Point newCentroid;
-        for (int p = 0; p < clusterSize; p++)
-        {
-            Point& point = _clusters[clusterId].Points[p];
-            newCentroid.X += point.X;
-            newCentroid.Y += point.Y;
-        }
-        newCentroid.X /= clusterSize;
-        newCentroid.Y /= clusterSize;
-        
-        _clusters[clusterId].Centroid = newCentroid;
+        for (int d = 0; d < _points.GetDimensions(); d++) _centroids.Set((int)k, d, _clusters[k].Centroid[d]);
     }
+    if (_search == CentroidSearch::KdTree) _tree.Build(_centroids);
 }
 
-void CsvProcessor::PerformClusterization(uint32_t K, uint8_t threadCount)
+bool CsvProcessor::PerformClusterization(uint32_t K, uint8_t threadCount, const ClusteringOptions& options)
 {
     std::cout << "---------------------------------------------------------" << std::endl;
     std::cout << "Started processing with " << (int)threadCount << " thread(s)" << std::endl;
     _tsBegin = std::chrono::steady_clock::now();
 
-    uint32_t pointsCount = _points.size();
+    uint32_t pointsCount = _points.GetCount();
+    const int dimensions = _points.GetDimensions();
+    ThreadPool& pool = ThreadPool::Shared(threadCount);
 
-    // // Initializing Clusters
-    std::vector<int> usedPointIds;
-    static int iters = 10;
-    for (int i = 1; i <= K; i++)
-    {
-        while (true)
-        {
-            int index = rand() % pointsCount;
+    _kernels = GetDistanceKernels(dimensions);
+    std::cout << dimensions << " dimension(s), " << SimdLevelName(_kernels.Level) << " distance kernels" << std::endl;
 
-            if (find(usedPointIds.begin(), usedPointIds.end(), index) ==
-                usedPointIds.end())
-            {
-                usedPointIds.push_back(index);
-                _points[index].ClusterId = i;
-                Cluster cluster(i, _points[index]);
-                _clusters.push_back(cluster);
-                break;
-            }
-        }
+    if (K == 0 || K > pointsCount)
+    {
+        std::cout << "K must be between 1 and the point count (" << pointsCount << ")" << std::endl;
+        return false;
     }
-    std::cout << "Clusters initialized = " << _clusters.size() << std::endl;
 
-    std::cout << "Running K-Means Clustering.." << std::endl;
+    // Initializing Clusters
+    auto tsSeeding = std::chrono::steady_clock::now();
+    std::vector<uint32_t> seeds = SeedCentroids(_points, K, options.Seeding, options.Seed, _kernels, pool);
 
-    int iter = 1;
-    while (true)
+    _assignments.assign(pointsCount, -1);
+    _clusters.clear();
+    for (uint32_t i = 0; i < K; i++)
     {
-        std::cout << "Iter - " << iter << "/" << iters << std::endl;
-        // _clusterizationDone = true;
-
-        // Add all points to their nearest cluster
-        // #pragma omp parallel for reduction(&&: _clusterizationDne) num_threads(16)
-       if (threadCount == 1)
-       {
-            CalculateNearestClusterForDots(0, pointsCount);
-       }
-       else
-       {
-            int step = pointsCount / threadCount;
-            for (int i = 0; i < threadCount; i++)
-            {
-                int start = i * step;
-                int end = (i + 1) * step + 1;
-                if (i == threadCount - 1) end = pointsCount;
-                _threads.push_back(std::thread(&CsvProcessor::CalculateNearestClusterForDots, this, start, end));
-            }
-        
-            for (auto& thread : _threads)
-            {
-                if (thread.joinable()) thread.join();
-            }
-
-            _threads.clear();
-       }
-
-        // clear all existing clusters
-        ClearClusterPoints();
-
-
-        // reassign points to their new clusters
-        for (int i = 0; i < pointsCount; i++)
+        _assignments[seeds[i]] = i;
+        std::vector<double> centroid(dimensions);
+        _points.Gather(seeds[i], centroid.data());
+        _clusters.emplace_back(i + 1, std::move(centroid));
+    }
+    _assignment = options.Assignment == AssignmentMethod::Lloyd ? AssignmentMethod::Lloyd : _bounds.Reset(options.Assignment, pointsCount, K);
+    // Elkan needs the distance to every centroid, the tree can't save it anything
+    _search = _assignment == AssignmentMethod::Elkan ? CentroidSearch::Brute : ResolveCentroidSearch(options.Search, K, dimensions);
+    _centroids.Resize(K, dimensions);
+    UpdateCentroidSet();
+    PrepareCentroidSums(K);
+
+    std::cout << "Clusters initialized = " << _clusters.size() << " (" << SeedingMethodName(options.Seeding) << ", seed " << options.Seed <<
+        ") in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tsSeeding).count() <<
+        " ms" << std::endl;
+
+    std::cout << "Running K-Means Clustering (" << AssignmentMethodName(_assignment) << " assignment, " <<
+        CentroidSearchName(_search) << " search).." << std::endl;
+
+    _iterationStats.clear();
+    const size_t blockCount = _blockCounts.size() / K;
+    for (uint32_t iter = 1; ; iter++)
+    {
+        auto tsIteration = std::chrono::steady_clock::now();
+
+        // Add all points to their nearest cluster, summing them per block on the way
+        pool.ParallelFor(0, blockCount, [this](size_t first, size_t last) {
+            for (size_t block = first; block < last; block++) AssignAndSumBlock(block);
+        }, 1);
+
+        double maxShift = RecalculateClusterCentroids(pool);
+        UpdateCentroidSet();
+        if (_assignment != AssignmentMethod::Lloyd) _bounds.Update(_centroids, _centroidShifts, pool);
+
+        IterationStats stats;
+        stats.Iteration = iter;
+        stats.Inertia = std::accumulate(_clusterInertia.begin(), _clusterInertia.end(), 0.0);
+        stats.Reassigned = std::accumulate(_blockReassigned.begin(), _blockReassigned.end(), uint64_t(0));
+        stats.Distances = std::accumulate(_blockDistances.begin(), _blockDistances.end(), uint64_t(0));
+        stats.MaxShift = maxShift;
+        stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tsIteration).count();
+        _iterationStats.push_back(stats);
+
+        std::cout << "Iter - " << iter << "/" << options.MaxIterations << ": " << stats.Reassigned << " reassigned, " <<
+            stats.Distances << " distances, inertia " <<
+            stats.Inertia << ", max shift " << stats.MaxShift << ", " << std::fixed << std::setprecision(3) <<
+            stats.Milliseconds << " ms" << std::defaultfloat << std::setprecision(6) << std::endl;
+
+        if (stats.Reassigned == 0 || maxShift <= options.Tolerance)
         {
-            // cluster index is ID-1
-            _clusters[_points[i].ClusterId - 1].Points.push_back(_points[i]);
+            std::cout << "Clustering converged in iteration : " << iter << std::endl;
+            break;
         }
-
-        if (threadCount == 1)
+        if (iter >= options.MaxIterations)
         {
-            for (int i = 0; i < K; i++)
-            {
-                RecalculateClusterCentroids(i, K, pointsCount);
-            }
+            std::cout << "Clustering stopped after " << iter << " iterations without converging" << std::endl;
+            break;
         }
-        else
-        {
-            for (int i = 0; i < K; i++)
-            {
-                _threads.push_back(std::thread(&CsvProcessor::RecalculateClusterCentroids, this, i, K, pointsCount));
-            }
-
-            for (auto& thread : _threads)
-            {
-                if (thread.joinable()) thread.join();
-            }
+    }
 
-            _threads.clear();
-        }
+    CollectClusterPoints();
 
-        if ( iter >= iters)
+    std::cout << "---------------------------------------------------------" << std::endl;
+    auto tsSilhouette = std::chrono::steady_clock::now();
+    _silhouette = ComputeSilhouette(_points, _assignments, _centroids, options.Silhouette, options.SilhouetteSamples, options.Seed,
+                                    _kernels, pool);
+    if (_silhouette.Method != SilhouetteMethod::None)
+    {
+        std::cout << "Silhouette: ";
+        if (!_silhouette.Valid) std::cout << "n/a (fewer than 2 non-empty clusters)";
+        else if (_silhouette.Method == SilhouetteMethod::Sampled)
         {
-            std::cout << "Clustering completed in iteration : " << iter << std::endl;
-            break;
+            std::cout << _silhouette.Value << " +- " << _silhouette.Margin << " (sampled, " << _silhouette.Samples <<
+                " points, 95% confidence)";
         }
-        iter++;
+        else std::cout << _silhouette.Value << " (" << SilhouetteMethodName(_silhouette.Method) << ")";
+        std::cout << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tsSilhouette).count() <<
+            " ms" << std::endl;
     }
-
-    std::cout << "---------------------------------------------------------" << std::endl;
-    std::cout << "Silhouette: " << CalculateSilhouette(K, pointsCount, threadCount) << std::endl;
     _tsEnd= std::chrono::steady_clock::now();
-    std::cout << "Ended processing. Time elapsed: " << 
+    std::cout << "Ended processing. Time elapsed: " <<
         std::chrono::duration_cast<std::chrono::milliseconds>(_tsEnd - _tsBegin).count() << " ms (" <<
         std::chrono::duration_cast<std::chrono::nanoseconds>(_tsEnd - _tsBegin).count() << ")" << std::endl;
+    return true;
+}
+
+bool CsvProcessor::SaveIterationStats(const std::string& filename) const
+{
+    FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file)
+    {
+        std::cerr << "Couldn't write file: " << filename << "\n";
+        return false;
+    }
+
+    std::fprintf(file, "iteration,ms,inertia,reassigned,distances,max_shift\n");
+    for (const IterationStats& stats : _iterationStats)
+    {
+        std::fprintf(file, "%u,%.3f,%.17g,%llu,%llu,%.17g\n", stats.Iteration, stats.Milliseconds, stats.Inertia,
+                     (unsigned long long)stats.Reassigned, (unsigned long long)stats.Distances, stats.MaxShift);
+    }
+
+    bool written = std::fclose(file) == 0;
+    if (!written) std::cerr << "Couldn't write file: " << filename << "\n";
+    return written;
 }
 
-void CsvProcessor::ClampToOne(std::vector<Point>& points, double maxX, double maxY)
+void CsvProcessor::ClampToOne(PointSet& points, const std::vector<double>& maxima, ThreadPool& pool)
 {
-    for (auto it = points.begin(); it != points.end(); it++)
+    for (int d = 0; d < points.GetDimensions(); d++)
     {
-        it->X /= maxX;
-        it->Y /= maxY;
+        double* column = points.Column(d);
+        pool.ParallelFor(0, points.GetCount(), [&](size_t start, size_t end) {
+            for (size_t i = start; i < end; i++) column[i] /= maxima[d];
+        });
     }
-}
\ No newline at end of file
+}
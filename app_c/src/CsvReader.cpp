@@ -0,0 +1,398 @@
+#include "CsvReader.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <MappedFile.hpp>
+#include <ThreadPool.hpp>
+
+namespace
+{
+    // bytes of the file parsed by one task, a chunk holds the lines starting inside it
+    constexpr size_t ChunkBytes = 4 << 20;
+
+    struct ChunkValues {
+        std::vector<std::vector<double>> Values;
+        size_t SkippedRows = 0;
+    };
+
+    // a requested column: its index in the line and where its values go
+    struct Field {
+        int Index;
+        size_t Column;
+    };
+
+    bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    bool ParseNumber(const char* first, const char* last, double& value)
+    {
+        while (first < last && IsBlank(*first)) first++;
+        while (last > first && IsBlank(last[-1])) last--;
+        // from_chars takes no leading '+'
+        if (last - first > 1 && first[0] == '+' && first[1] != '-') first++;
+        if (first == last) return false;
+
+#if defined(__cpp_lib_to_chars)
+        auto [end, error] = std::from_chars(first, last, value);
+        return error == std::errc() && end == last;
+#else
+        // standard libraries without floating point from_chars: strtod on a terminated copy
+        char text[64];
+        size_t length = last - first;
+        if (length >= sizeof(text)) return false;
+        std::memcpy(text, first, length);
+        text[length] = '\0';
+        char* end = nullptr;
+        value = std::strtod(text, &end);
+        return end == text + length;
+#endif
+    }
+
+    const char* FindByte(const char* first, const char* last, char byte)
+    {
+        const void* found = std::memchr(first, byte, last - first);
+        return found ? static_cast<const char*>(found) : last;
+    }
+
+    std::vector<std::string> SplitHeader(const char* first, const char* last)
+    {
+        while (last > first && last[-1] == '\r') last--;
+
+        std::vector<std::string> names;
+        for (const char* field = first; ; )
+        {
+            const char* fieldEnd = FindByte(field, last, ',');
+            names.emplace_back(field, fieldEnd);
+            if (fieldEnd == last) break;
+            field = fieldEnd + 1;
+        }
+        return names;
+    }
+
+    bool IsBlankLine(const char* first, const char* last)
+    {
+        return std::all_of(first, last, IsBlank);
+    }
+
+    // first line starting at or after data + begin, a line running into the chunk belongs to the chunk before
+    const char* FirstLine(const char* data, size_t size, size_t begin)
+    {
+        const char* line = data + begin;
+        if (begin == 0 || line[-1] == '\n') return line;
+
+        const char* lineEnd = FindByte(line, data + size, '\n');
+        return lineEnd == data + size ? lineEnd : lineEnd + 1;
+    }
+
+    // The mapped file and its header, data lines start at DataBegin and are split into chunks of ChunkBytes
+    struct CsvFile {
+        MappedFile File;
+        const char* Data = nullptr;
+        size_t Size = 0;
+        size_t DataBegin = 0;
+
+        bool Open(const std::string& filename, std::vector<std::string>& header)
+        {
+            if (!File.OpenRead(filename) || File.Size() == 0)
+            {
+                std::cout << "Couldn't read file: " << filename << "\n";
+                return false;
+            }
+            File.AdviseSequential();
+
+            Data = reinterpret_cast<const char*>(File.Data());
+            Size = File.Size();
+            const char* headerEnd = FindByte(Data, Data + Size, '\n');
+            header = SplitHeader(Data, headerEnd);
+            DataBegin = std::min((size_t)(headerEnd - Data) + 1, Size);
+            return true;
+        }
+
+        size_t GetChunkCount() const { return (Size - DataBegin + ChunkBytes - 1) / ChunkBytes; }
+        size_t GetChunkBegin(size_t chunk) const { return DataBegin + chunk * ChunkBytes; }
+        size_t GetChunkEnd(size_t chunk) const { return std::min(GetChunkBegin(chunk) + ChunkBytes, Size); }
+    };
+
+    // Lines starting in [begin, end) of data, fields sorted by index
+    void ParseLines(const char* data, size_t size, size_t begin, size_t end, const std::vector<Field>& fields, ChunkValues& chunk)
+    {
+        const char* fileEnd = data + size;
+        const char* line = FirstLine(data, size, begin);
+
+        std::vector<double> row(fields.size());
+        while (line < data + end)
+        {
+            const char* lineEnd = FindByte(line, fileEnd, '\n');
+
+            // field `index` starts at `field`, nullptr past the last field of the line
+            const char* field = line;
+            int index = 0;
+            bool numeric = true;
+            for (size_t f = 0; f < fields.size(); f++)
+            {
+                const Field& wanted = fields[f];
+                // the same column asked for twice
+                if (wanted.Index < index)
+                {
+                    row[wanted.Column] = row[fields[f - 1].Column];
+                    continue;
+                }
+
+                for (; index < wanted.Index && field; index++)
+                {
+                    const char* comma = FindByte(field, lineEnd, ',');
+                    field = comma == lineEnd ? nullptr : comma + 1;
+                }
+
+                const char* fieldEnd = field ? FindByte(field, lineEnd, ',') : nullptr;
+                if (!field || !ParseNumber(field, fieldEnd, row[wanted.Column]))
+                {
+                    numeric = false;
+                    break;
+                }
+                field = fieldEnd == lineEnd ? nullptr : fieldEnd + 1;
+                index++;
+            }
+
+            if (numeric)
+            {
+                for (size_t c = 0; c < fields.size(); c++) chunk.Values[c].push_back(row[c]);
+            }
+            else if (!IsBlankLine(line, lineEnd))
+            {
+                chunk.SkippedRows++;
+            }
+
+            if (lineEnd == fileEnd) break;
+            line = lineEnd + 1;
+        }
+    }
+
+    // every field of the non-blank lines starting in [begin, end), `columns` fields per row
+    struct ChunkTable {
+        std::vector<std::vector<double>> Values;
+        std::vector<std::vector<uint8_t>> Valid;
+        std::vector<bool> Numeric;
+        size_t RowCount = 0;
+    };
+
+    void ParseTableLines(const char* data, size_t size, size_t begin, size_t end, size_t columns, ChunkTable& chunk)
+    {
+        const char* fileEnd = data + size;
+        const char* line = FirstLine(data, size, begin);
+
+        chunk.Values.resize(columns);
+        chunk.Valid.resize(columns);
+        chunk.Numeric.assign(columns, false);
+        while (line < data + end)
+        {
+            const char* lineEnd = FindByte(line, fileEnd, '\n');
+            if (!IsBlankLine(line, lineEnd))
+            {
+                // fields missing at the end of the line are not numbers
+                const char* field = line;
+                for (size_t c = 0; c < columns; c++)
+                {
+                    double value = 0.0;
+                    const char* fieldEnd = field ? FindByte(field, lineEnd, ',') : nullptr;
+                    bool valid = field && ParseNumber(field, fieldEnd, value);
+                    chunk.Values[c].push_back(valid ? value : 0.0);
+                    chunk.Valid[c].push_back(valid);
+                    if (valid) chunk.Numeric[c] = true;
+                    field = field && fieldEnd != lineEnd ? fieldEnd + 1 : nullptr;
+                }
+                chunk.RowCount++;
+            }
+
+            if (lineEnd == fileEnd) break;
+            line = lineEnd + 1;
+        }
+    }
+}
+
+bool ReadCsvColumns(const std::string& filename, const std::vector<std::string>& columns, CsvColumns& result, ThreadPool& pool)
+{
+    result = CsvColumns();
+    CsvFile file;
+    if (!file.Open(filename, result.Header)) return false;
+
+    std::vector<Field> fields;
+    for (size_t c = 0; c < columns.size(); c++)
+    {
+        auto found = std::find(result.Header.begin(), result.Header.end(), columns[c]);
+        if (found == result.Header.end())
+        {
+            std::cout << "Column " << columns[c] << " was not found in " << filename << "\n";
+            return false;
+        }
+        result.Ids.push_back((int)(found - result.Header.begin()));
+        fields.push_back({ result.Ids.back(), c });
+    }
+    std::sort(fields.begin(), fields.end(), [](const Field& lhs, const Field& rhs) { return lhs.Index < rhs.Index; });
+
+    const size_t chunkCount = file.GetChunkCount();
+    std::vector<ChunkValues> chunks(chunkCount);
+
+    pool.ParallelFor(0, chunkCount, [&](size_t firstChunk, size_t endChunk) {
+        for (size_t chunk = firstChunk; chunk < endChunk; chunk++)
+        {
+            chunks[chunk].Values.resize(columns.size());
+            ParseLines(file.Data, file.Size, file.GetChunkBegin(chunk), file.GetChunkEnd(chunk), fields, chunks[chunk]);
+        }
+    }, 1);
+
+    // chunks are concatenated in file order
+    std::vector<size_t> offsets(chunkCount + 1, 0);
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        offsets[chunk + 1] = offsets[chunk] + (columns.empty() ? 0 : chunks[chunk].Values[0].size());
+        result.SkippedRows += chunks[chunk].SkippedRows;
+    }
+
+    result.Values.resize(columns.size());
+    for (std::vector<double>& values : result.Values) values.resize(offsets[chunkCount]);
+
+    pool.ParallelFor(0, chunkCount, [&](size_t firstChunk, size_t endChunk) {
+        for (size_t chunk = firstChunk; chunk < endChunk; chunk++)
+        {
+            for (size_t c = 0; c < columns.size(); c++)
+            {
+                std::vector<double>& values = chunks[chunk].Values[c];
+                std::copy(values.begin(), values.end(), result.Values[c].begin() + offsets[chunk]);
+                std::vector<double>().swap(values);
+            }
+        }
+    }, 1);
+
+    return true;
+}
+
+bool ReadCsvTable(const std::string& filename, CsvTable& table, ThreadPool& pool)
+{
+    table = CsvTable();
+    CsvFile file;
+    if (!file.Open(filename, table.Header)) return false;
+
+    const size_t columns = table.Header.size();
+    const size_t chunkCount = file.GetChunkCount();
+    std::vector<ChunkTable> chunks(chunkCount);
+
+    pool.ParallelFor(0, chunkCount, [&](size_t firstChunk, size_t endChunk) {
+        for (size_t chunk = firstChunk; chunk < endChunk; chunk++)
+        {
+            ParseTableLines(file.Data, file.Size, file.GetChunkBegin(chunk), file.GetChunkEnd(chunk), columns, chunks[chunk]);
+        }
+    }, 1);
+
+    std::vector<size_t> offsets(chunkCount + 1, 0);
+    std::vector<bool> numeric(columns, false);
+    for (size_t chunk = 0; chunk < chunkCount; chunk++)
+    {
+        offsets[chunk + 1] = offsets[chunk] + chunks[chunk].RowCount;
+        for (size_t c = 0; c < columns; c++) numeric[c] = numeric[c] || chunks[chunk].Numeric[c];
+    }
+    table.RowCount = offsets[chunkCount];
+
+    table.Values.resize(columns);
+    table.Valid.resize(columns);
+    for (size_t c = 0; c < columns; c++)
+    {
+        if (!numeric[c]) continue;
+        table.Values[c].resize(table.RowCount);
+        table.Valid[c].resize(table.RowCount);
+    }
+
+    pool.ParallelFor(0, chunkCount, [&](size_t firstChunk, size_t endChunk) {
+        for (size_t chunk = firstChunk; chunk < endChunk; chunk++)
+        {
+            for (size_t c = 0; c < columns; c++)
+            {
+                ChunkTable& part = chunks[chunk];
+                if (numeric[c])
+                {
+                    std::copy(part.Values[c].begin(), part.Values[c].end(), table.Values[c].begin() + offsets[chunk]);
+                    std::copy(part.Valid[c].begin(), part.Valid[c].end(), table.Valid[c].begin() + offsets[chunk]);
+                }
+                std::vector<double>().swap(part.Values[c]);
+                std::vector<uint8_t>().swap(part.Valid[c]);
+            }
+        }
+    }, 1);
+
+    return true;
+}
+
+void SelectCsvRows(const std::vector<CsvColumnView>& columns, size_t rowCount, CsvColumns& result, ThreadPool& pool)
+{
+    // rows are counted per block first so every block knows where its rows go
+    const size_t blockRows = 64 * 1024;
+    const size_t blockCount = (rowCount + blockRows - 1) / blockRows;
+    const bool text = std::any_of(columns.begin(), columns.end(), [](const CsvColumnView& view) { return !view.Values; });
+
+    auto isSelected = [&](size_t row) {
+        for (const CsvColumnView& view : columns)
+        {
+            if (!view.Valid[row]) return false;
+        }
+        return true;
+    };
+
+    std::vector<size_t> offsets(blockCount + 1, 0);
+    if (!text)
+    {
+        pool.ParallelFor(0, blockCount, [&](size_t firstBlock, size_t endBlock) {
+            for (size_t block = firstBlock; block < endBlock; block++)
+            {
+                size_t count = 0;
+                for (size_t row = block * blockRows; row < std::min((block + 1) * blockRows, rowCount); row++) count += isSelected(row);
+                offsets[block + 1] = count;
+            }
+        }, 1);
+    }
+    for (size_t block = 0; block < blockCount; block++) offsets[block + 1] += offsets[block];
+
+    const size_t selected = offsets[blockCount];
+    result.Values.assign(columns.size(), std::vector<double>(selected));
+    result.SkippedRows = rowCount - selected;
+    if (selected == 0) return;
+
+    pool.ParallelFor(0, blockCount, [&](size_t firstBlock, size_t endBlock) {
+        for (size_t block = firstBlock; block < endBlock; block++)
+        {
+            size_t out = offsets[block];
+            for (size_t row = block * blockRows; row < std::min((block + 1) * blockRows, rowCount); row++)
+            {
+                if (!isSelected(row)) continue;
+                for (size_t c = 0; c < columns.size(); c++) result.Values[c][out] = columns[c].Values[row];
+                out++;
+            }
+        }
+    }, 1);
+}
+
+bool ViewCsvColumns(const CsvTable& table, const std::vector<std::string>& names, std::vector<CsvColumnView>& views, std::vector<int>& ids)
+{
+    views.clear();
+    ids.clear();
+    for (const std::string& name : names)
+    {
+        auto found = std::find(table.Header.begin(), table.Header.end(), name);
+        if (found == table.Header.end())
+        {
+            std::cout << "Column " << name << " was not found\n";
+            return false;
+        }
+
+        size_t column = found - table.Header.begin();
+        ids.push_back((int)column);
+        views.push_back(table.IsNumeric(column) ? CsvColumnView{ table.Values[column].data(), table.Valid[column].data() }
+                                                : CsvColumnView{ nullptr, nullptr });
+    }
+    return true;
+}
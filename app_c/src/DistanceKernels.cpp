@@ -0,0 +1,65 @@
+#include "DistanceKernelsImpl.hpp"
+
+#include <algorithm>
+#include <limits>
+
+void CentroidSet::Resize(int count, int dimensions)
+{
+    _count = count;
+    _dimensions = dimensions;
+    _stride = ((size_t)count + Lanes - 1) / Lanes * Lanes;
+    _values.assign(_stride * dimensions, 0.0);
+
+    for (int d = 0; d < dimensions; d++)
+    {
+        std::fill(Row(d) + count, Row(d) + _stride, std::numeric_limits<double>::infinity());
+    }
+}
+
+template <int Dimensions>
+static DistanceKernels ScalarKernels()
+{
+    return { SimdLevel::Scalar, &NearestCentroidScalar<Dimensions>, &CentroidDistancesScalar<Dimensions>, &DistanceSumScalar<Dimensions> };
+}
+
+static DistanceKernels SelectScalar(int dimensions)
+{
+    switch (dimensions)
+    {
+        case 2: return ScalarKernels<2>();
+        case 3: return ScalarKernels<3>();
+        case 4: return ScalarKernels<4>();
+        case 8: return ScalarKernels<8>();
+        case 16: return ScalarKernels<16>();
+        default: return ScalarKernels<0>();
+    }
+}
+
+#if defined(APP_C_X86_SIMD)
+template <int Dimensions>
+static DistanceKernels Avx2Kernels()
+{
+    return { SimdLevel::Avx2, &NearestCentroidAvx2<Dimensions>, &CentroidDistancesAvx2<Dimensions>, &DistanceSumAvx2<Dimensions> };
+}
+
+static DistanceKernels SelectAvx2(int dimensions)
+{
+    switch (dimensions)
+    {
+        case 2: return Avx2Kernels<2>();
+        case 3: return Avx2Kernels<3>();
+        case 4: return Avx2Kernels<4>();
+        case 8: return Avx2Kernels<8>();
+        case 16: return Avx2Kernels<16>();
+        default: return Avx2Kernels<0>();
+    }
+}
+#endif
+
+DistanceKernels GetDistanceKernels(int dimensions)
+{
+#if defined(APP_C_X86_SIMD)
+    if (GetSimdLevel() == SimdLevel::Avx2) return SelectAvx2(dimensions);
+#endif
+    return SelectScalar(dimensions);
+}
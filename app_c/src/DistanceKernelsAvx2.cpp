@@ -0,0 +1,133 @@
+// Compiled with -mavx2, only reached after GetSimdLevel() reported AVX2 support
+#include "DistanceKernelsImpl.hpp"
+
+#if defined(APP_C_X86_SIMD)
+
+#include <cmath>
+#include <limits>
+
+#include <immintrin.h>
+
+// One block of 4 centroids per vector. Every lane keeps its own nearest centroid, the lanes are merged at the end;
+// no FMA, so the sums round exactly as in the scalar version
+template <int Dimensions>
+int NearestCentroidAvx2(const double* point, const CentroidSet& centroids, double& distance)
+{
+    static_assert(CentroidSet::Lanes == 4, "one AVX2 vector per block of centroids");
+    const int dimensions = Dimensions > 0 ? Dimensions : centroids.GetDimensions();
+    const int count = centroids.GetCount();
+    const size_t stride = centroids.GetStride();
+    const double* rows = centroids.Row(0);
+
+    __m256d best = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d bestIndex = _mm256_setzero_pd();
+    __m256d index = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+    const __m256d step = _mm256_set1_pd(4.0);
+
+    for (int first = 0; first < count; first += 4)
+    {
+        __m256d sum = _mm256_setzero_pd();
+        for (int d = 0; d < dimensions; d++)
+        {
+            __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(rows + d * stride + first), _mm256_broadcast_sd(point + d));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(diff, diff));
+        }
+
+        __m256d closer = _mm256_cmp_pd(sum, best, _CMP_LT_OQ);
+        best = _mm256_blendv_pd(best, sum, closer);
+        bestIndex = _mm256_blendv_pd(bestIndex, index, closer);
+        index = _mm256_add_pd(index, step);
+    }
+
+    double lanes[4], indices[4];
+    _mm256_storeu_pd(lanes, best);
+    _mm256_storeu_pd(indices, bestIndex);
+
+    int lane = 0;
+    for (int other = 1; other < 4; other++)
+    {
+        if (lanes[other] < lanes[lane] || (lanes[other] == lanes[lane] && indices[other] < indices[lane])) lane = other;
+    }
+
+    distance = lanes[lane];
+    return (int)indices[lane];
+}
+
+template <int Dimensions>
+void CentroidDistancesAvx2(const double* point, const CentroidSet& centroids, double* distances)
+{
+    const int dimensions = Dimensions > 0 ? Dimensions : centroids.GetDimensions();
+    const int count = centroids.GetCount();
+    const size_t stride = centroids.GetStride();
+    const double* rows = centroids.Row(0);
+
+    for (int first = 0; first < count; first += 4)
+    {
+        __m256d sum = _mm256_setzero_pd();
+        for (int d = 0; d < dimensions; d++)
+        {
+            __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(rows + d * stride + first), _mm256_broadcast_sd(point + d));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(diff, diff));
+        }
+        _mm256_storeu_pd(distances + first, sum);
+    }
+}
+
+// Same order of additions as DistanceSumScalar, one vector of 4 points per block
+template <int Dimensions>
+double DistanceSumAvx2(const double* point, const double* columns, size_t stride, int dimensions, size_t count)
+{
+    if (Dimensions > 0) dimensions = Dimensions;
+
+    __m256d total = _mm256_setzero_pd();
+    size_t first = 0;
+    for (; first + 4 <= count; first += 4)
+    {
+        __m256d sum = _mm256_setzero_pd();
+        for (int d = 0; d < dimensions; d++)
+        {
+            __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(columns + d * stride + first), _mm256_broadcast_sd(point + d));
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(diff, diff));
+        }
+        total = _mm256_add_pd(total, _mm256_sqrt_pd(sum));
+    }
+
+    double remainder = 0.0;
+    for (; first < count; first++)
+    {
+        double sum = 0.0;
+        for (int d = 0; d < dimensions; d++)
+        {
+            double diff = columns[d * stride + first] - point[d];
+            sum += diff * diff;
+        }
+        remainder += std::sqrt(sum);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, total);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + remainder;
+}
+
+template int NearestCentroidAvx2<0>(const double*, const CentroidSet&, double&);
+template int NearestCentroidAvx2<2>(const double*, const CentroidSet&, double&);
+template int NearestCentroidAvx2<3>(const double*, const CentroidSet&, double&);
+template int NearestCentroidAvx2<4>(const double*, const CentroidSet&, double&);
+template int NearestCentroidAvx2<8>(const double*, const CentroidSet&, double&);
+template int NearestCentroidAvx2<16>(const double*, const CentroidSet&, double&);
+
+template void CentroidDistancesAvx2<0>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesAvx2<2>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesAvx2<3>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesAvx2<4>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesAvx2<8>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesAvx2<16>(const double*, const CentroidSet&, double*);
+
+template double DistanceSumAvx2<0>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumAvx2<2>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumAvx2<3>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumAvx2<4>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumAvx2<8>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumAvx2<16>(const double*, const double*, size_t, int, size_t);
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "DistanceKernels.hpp"
+
+// Per instruction set implementations, only called through GetDistanceKernels().
+// Dimensions > 0 is the unrolled version for that many coordinates, 0 reads the count from the centroids.
+
+template <int Dimensions>
+int NearestCentroidScalar(const double* point, const CentroidSet& centroids, double& distance);
+template <int Dimensions>
+void CentroidDistancesScalar(const double* point, const CentroidSet& centroids, double* distances);
+template <int Dimensions>
+double DistanceSumScalar(const double* point, const double* columns, size_t stride, int dimensions, size_t count);
+
+#if defined(APP_C_X86_SIMD)
+template <int Dimensions>
+int NearestCentroidAvx2(const double* point, const CentroidSet& centroids, double& distance);
+template <int Dimensions>
+void CentroidDistancesAvx2(const double* point, const CentroidSet& centroids, double* distances);
+template <int Dimensions>
+double DistanceSumAvx2(const double* point, const double* columns, size_t stride, int dimensions, size_t count);
+#endif
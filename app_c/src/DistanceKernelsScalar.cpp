@@ -0,0 +1,128 @@
+#include "DistanceKernelsImpl.hpp"
+
+#include <cmath>
+#include <limits>
+
+// Lanes centroids per block, the lane loops are left to the compiler to vectorize
+template <int Dimensions>
+int NearestCentroidScalar(const double* point, const CentroidSet& centroids, double& distance)
+{
+    constexpr int Lanes = CentroidSet::Lanes;
+    const int dimensions = Dimensions > 0 ? Dimensions : centroids.GetDimensions();
+    const int count = centroids.GetCount();
+    const size_t stride = centroids.GetStride();
+    const double* rows = centroids.Row(0);
+
+    double best = std::numeric_limits<double>::infinity();
+    int nearest = 0;
+    for (int first = 0; first < count; first += Lanes)
+    {
+        double sum[Lanes] = {};
+        for (int d = 0; d < dimensions; d++)
+        {
+            const double* row = rows + d * stride + first;
+            for (int lane = 0; lane < Lanes; lane++)
+            {
+                double diff = row[lane] - point[d];
+                sum[lane] += diff * diff;
+            }
+        }
+
+        for (int lane = 0; lane < Lanes; lane++)
+        {
+            if (sum[lane] < best)
+            {
+                best = sum[lane];
+                nearest = first + lane;
+            }
+        }
+    }
+
+    distance = best;
+    return nearest;
+}
+
+template <int Dimensions>
+void CentroidDistancesScalar(const double* point, const CentroidSet& centroids, double* distances)
+{
+    constexpr int Lanes = CentroidSet::Lanes;
+    const int dimensions = Dimensions > 0 ? Dimensions : centroids.GetDimensions();
+    const int count = centroids.GetCount();
+    const size_t stride = centroids.GetStride();
+    const double* rows = centroids.Row(0);
+
+    for (int first = 0; first < count; first += Lanes)
+    {
+        double sum[Lanes] = {};
+        for (int d = 0; d < dimensions; d++)
+        {
+            const double* row = rows + d * stride + first;
+            for (int lane = 0; lane < Lanes; lane++)
+            {
+                double diff = row[lane] - point[d];
+                sum[lane] += diff * diff;
+            }
+        }
+        for (int lane = 0; lane < Lanes; lane++) distances[first + lane] = sum[lane];
+    }
+}
+
+// Lanes points per block summed per lane, the remainder one by one, then ((0 + 1) + (2 + 3)) + remainder
+template <int Dimensions>
+double DistanceSumScalar(const double* point, const double* columns, size_t stride, int dimensions, size_t count)
+{
+    constexpr int Lanes = CentroidSet::Lanes;
+    if (Dimensions > 0) dimensions = Dimensions;
+
+    double total[Lanes] = {};
+    size_t first = 0;
+    for (; first + Lanes <= count; first += Lanes)
+    {
+        double sum[Lanes] = {};
+        for (int d = 0; d < dimensions; d++)
+        {
+            const double* column = columns + d * stride + first;
+            for (int lane = 0; lane < Lanes; lane++)
+            {
+                double diff = column[lane] - point[d];
+                sum[lane] += diff * diff;
+            }
+        }
+        for (int lane = 0; lane < Lanes; lane++) total[lane] += std::sqrt(sum[lane]);
+    }
+
+    double remainder = 0.0;
+    for (; first < count; first++)
+    {
+        double sum = 0.0;
+        for (int d = 0; d < dimensions; d++)
+        {
+            double diff = columns[d * stride + first] - point[d];
+            sum += diff * diff;
+        }
+        remainder += std::sqrt(sum);
+    }
+
+    return ((total[0] + total[1]) + (total[2] + total[3])) + remainder;
+}
+
+template int NearestCentroidScalar<0>(const double*, const CentroidSet&, double&);
+template int NearestCentroidScalar<2>(const double*, const CentroidSet&, double&);
+template int NearestCentroidScalar<3>(const double*, const CentroidSet&, double&);
+template int NearestCentroidScalar<4>(const double*, const CentroidSet&, double&);
+template int NearestCentroidScalar<8>(const double*, const CentroidSet&, double&);
+template int NearestCentroidScalar<16>(const double*, const CentroidSet&, double&);
+
+template void CentroidDistancesScalar<0>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesScalar<2>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesScalar<3>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesScalar<4>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesScalar<8>(const double*, const CentroidSet&, double*);
+template void CentroidDistancesScalar<16>(const double*, const CentroidSet&, double*);
+
+template double DistanceSumScalar<0>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumScalar<2>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumScalar<3>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumScalar<4>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumScalar<8>(const double*, const double*, size_t, int, size_t);
+template double DistanceSumScalar<16>(const double*, const double*, size_t, int, size_t);
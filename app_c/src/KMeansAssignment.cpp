@@ -0,0 +1,216 @@
+#include "KMeansAssignment.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <ThreadPool.hpp>
+
+namespace
+{
+    constexpr double Infinity = std::numeric_limits<double>::infinity();
+
+    // same sum as the distance kernels, so a bound never disagrees with the scan by a rounding
+    double PointDistance(const double* point, const CentroidSet& centroids, int centroid)
+    {
+        double sum = 0.0;
+        for (int d = 0; d < centroids.GetDimensions(); d++)
+        {
+            double diff = centroids.Get(centroid, d) - point[d];
+            sum += diff * diff;
+        }
+        return std::sqrt(sum);
+    }
+
+    double CentroidDistance(const CentroidSet& centroids, int first, int second)
+    {
+        double sum = 0.0;
+        for (int d = 0; d < centroids.GetDimensions(); d++)
+        {
+            double diff = centroids.Get(first, d) - centroids.Get(second, d);
+            sum += diff * diff;
+        }
+        return std::sqrt(sum);
+    }
+}
+
+bool ParseAssignmentMethod(const std::string& name, AssignmentMethod& method)
+{
+    if (name == "lloyd") method = AssignmentMethod::Lloyd;
+    else if (name == "hamerly") method = AssignmentMethod::Hamerly;
+    else if (name == "elkan") method = AssignmentMethod::Elkan;
+    else return false;
+    return true;
+}
+
+const char* AssignmentMethodName(AssignmentMethod method)
+{
+    switch (method)
+    {
+        case AssignmentMethod::Lloyd: return "lloyd";
+        case AssignmentMethod::Hamerly: return "hamerly";
+        case AssignmentMethod::Elkan: return "elkan";
+    }
+    return "unknown";
+}
+
+AssignmentMethod BoundedAssignment::Reset(AssignmentMethod method, size_t pointCount, int K)
+{
+    if (method == AssignmentMethod::Elkan &&
+        (pointCount + K) * (size_t)K > ElkanMaxBytes / sizeof(double)) method = AssignmentMethod::Hamerly;
+
+    _method = method;
+    _K = K;
+    _fresh = true;
+    _upper.assign(method == AssignmentMethod::Lloyd ? 0 : pointCount, Infinity);
+    _lower.assign(method == AssignmentMethod::Elkan ? pointCount * K : method == AssignmentMethod::Hamerly ? pointCount : 0, 0.0);
+    _shifts.assign(K, 0.0);
+    _halfNearest.assign(K, 0.0);
+    _halfDistances.assign(method == AssignmentMethod::Elkan ? (size_t)K * K : 0, 0.0);
+    return method;
+}
+
+void BoundedAssignment::Update(const CentroidSet& centroids, const std::vector<double>& shifts, ThreadPool& pool)
+{
+    _fresh = false;
+    _shifts = shifts;
+
+    _maxShift = _secondShift = 0.0;
+    _maxShiftCentroid = 0;
+    for (int k = 0; k < _K; k++)
+    {
+        if (_shifts[k] > _maxShift)
+        {
+            _secondShift = _maxShift;
+            _maxShift = _shifts[k];
+            _maxShiftCentroid = k;
+        }
+        else if (_shifts[k] > _secondShift) _secondShift = _shifts[k];
+    }
+
+    const bool elkan = _method == AssignmentMethod::Elkan;
+    pool.ParallelFor(0, _K, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; k++)
+        {
+            double nearest = Infinity;
+            for (int j = 0; j < _K; j++)
+            {
+                if (j == (int)k) continue;
+                double half = 0.5 * CentroidDistance(centroids, (int)k, j);
+                nearest = std::min(nearest, half);
+                if (elkan) _halfDistances[k * _K + j] = half;
+            }
+            _halfNearest[k] = nearest;
+        }
+    });
+}
+
+int BoundedAssignment::FullScan(size_t index, const double* point, const CentroidSet& centroids, const DistanceKernels& kernels)
+{
+    static thread_local std::vector<double> distances;
+    distances.resize(centroids.GetStride());
+    kernels.Distances(point, centroids, distances.data());
+
+    // nearest first on ties, as in the Lloyd scan
+    int nearest = 0;
+    double best = Infinity, second = Infinity;
+    for (int k = 0; k < _K; k++)
+    {
+        if (distances[k] < best)
+        {
+            second = best;
+            best = distances[k];
+            nearest = k;
+        }
+        else if (distances[k] < second) second = distances[k];
+    }
+
+    _upper[index] = std::sqrt(best);
+    if (_method == AssignmentMethod::Elkan)
+    {
+        double* lower = _lower.data() + index * _K;
+        for (int k = 0; k < _K; k++) lower[k] = std::sqrt(distances[k]);
+    }
+    else _lower[index] = std::sqrt(second);
+    return nearest;
+}
+
+int BoundedAssignment::TreeSearch(size_t index, const double* point, const CentroidTree& tree, uint64_t& evaluated)
+{
+    double best, second;
+    int nearest = tree.Nearest(point, best, &second, evaluated);
+    _upper[index] = std::sqrt(best);
+    _lower[index] = std::sqrt(second);
+    return nearest;
+}
+
+int BoundedAssignment::AssignHamerly(size_t index, const double* point, int current, const CentroidSet& centroids,
+                                     const DistanceKernels& kernels, const CentroidTree* tree, uint64_t& evaluated)
+{
+    double& upper = _upper[index];
+    double& lower = _lower[index];
+    upper += _shifts[current];
+    lower -= current == _maxShiftCentroid ? _secondShift : _maxShift;
+
+    const double bound = std::max(_halfNearest[current], lower);
+    if (upper <= bound) return current;
+
+    // tighten the upper bound before paying for the full scan
+    upper = PointDistance(point, centroids, current);
+    evaluated++;
+    if (upper <= bound) return current;
+
+    if (tree) return TreeSearch(index, point, *tree, evaluated);
+    evaluated += _K;
+    return FullScan(index, point, centroids, kernels);
+}
+
+int BoundedAssignment::AssignElkan(size_t index, const double* point, int current, const CentroidSet& centroids,
+                                   uint64_t& evaluated)
+{
+    double& upper = _upper[index];
+    double* lower = _lower.data() + index * _K;
+    upper += _shifts[current];
+    for (int k = 0; k < _K; k++) lower[k] = std::max(0.0, lower[k] - _shifts[k]);
+
+    if (upper <= _halfNearest[current]) return current;
+
+    bool tight = false;
+    for (int k = 0; k < _K; k++)
+    {
+        if (k == current || upper <= lower[k] || upper <= _halfDistances[(size_t)current * _K + k]) continue;
+
+        if (!tight)
+        {
+            upper = lower[current] = PointDistance(point, centroids, current);
+            evaluated++;
+            tight = true;
+            if (upper <= lower[k] || upper <= _halfDistances[(size_t)current * _K + k]) continue;
+        }
+
+        double distance = lower[k] = PointDistance(point, centroids, k);
+        evaluated++;
+        if (distance < upper || (distance == upper && k < current))
+        {
+            upper = distance;
+            current = k;
+        }
+    }
+    return current;
+}
+
+int BoundedAssignment::Assign(size_t index, const double* point, int current, const CentroidSet& centroids,
+                              const DistanceKernels& kernels, const CentroidTree* tree, uint64_t& evaluated)
+{
+    const bool elkan = _method == AssignmentMethod::Elkan;
+    if (_fresh || current < 0)
+    {
+        if (tree && !elkan) return TreeSearch(index, point, *tree, evaluated);
+        evaluated += _K;
+        return FullScan(index, point, centroids, kernels);
+    }
+
+    return elkan
+        ? AssignElkan(index, point, current, centroids, evaluated)
+        : AssignHamerly(index, point, current, centroids, kernels, tree, evaluated);
+}
@@ -0,0 +1,353 @@
+#include "KMeansSeeding.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
+
+#include <ThreadPool.hpp>
+
+#include "Random.hpp"
+
+namespace
+{
+    // points per distance update task, fixed so the results don't depend on the thread count
+    constexpr size_t BlockPoints = 16384;
+    // k-means|| sampling rounds and candidates drawn per round, in multiples of K
+    constexpr int ParallelRounds = 5;
+    constexpr double Oversampling = 2.0;
+
+    // independent stream of one block in one sampling round
+    Random BlockStream(uint64_t seed, uint64_t round, uint64_t block)
+    {
+        return Random(Random(Random(seed).Next() + round).Next() + block);
+    }
+
+    class Seeder
+    {
+        public:
+            Seeder(const PointSet& points, uint64_t seed, const DistanceKernels& kernels, ThreadPool& pool) :
+                _points(points),
+                _kernels(kernels),
+                _pool(pool),
+                _random(seed),
+                _seed(seed),
+                _count(points.GetCount()),
+                _blockCount((points.GetCount() + BlockPoints - 1) / BlockPoints),
+                _chosen(points.GetCount(), 0),
+                _minDistance(points.GetCount(), 0.0),
+                _blockCost(_blockCount, 0.0) {}
+
+            std::vector<uint32_t> DrawRandom(uint32_t K);
+            std::vector<uint32_t> DrawPlusPlus(uint32_t K);
+            std::vector<uint32_t> DrawParallel(uint32_t K);
+
+        private:
+            void Choose(uint32_t index, std::vector<uint32_t>& chosen);
+            // _minDistance = squared distance to the point `index`, or the smaller of both when `first` is false
+            void UpdateDistances(uint32_t index, bool first);
+            // same against several points at once through the distance kernels, when _nearestCandidate is in use
+            // it follows the nearest one, numbered from `firstCandidate`
+            void UpdateDistances(const std::vector<uint32_t>& indices, uint32_t firstCandidate);
+            double TotalCost() const { return std::accumulate(_blockCost.begin(), _blockCost.end(), 0.0); }
+            // a point drawn with probability _minDistance / total, an unchosen one when every distance is 0
+            uint32_t DrawWeighted(double total);
+            // k-means++ draws until `chosen` holds K points, _minDistance is up to date with it
+            void CompletePlusPlus(uint32_t K, std::vector<uint32_t>& chosen);
+
+            const PointSet& _points;
+            const DistanceKernels& _kernels;
+            ThreadPool& _pool;
+            Random _random;
+            uint64_t _seed;
+            size_t _count;
+            size_t _blockCount;
+            std::vector<uint8_t> _chosen;
+            std::vector<double> _minDistance;
+            std::vector<double> _blockCost;
+            // k-means|| only: candidate each point is nearest to
+            std::vector<uint32_t> _nearestCandidate;
+    };
+
+    void Seeder::Choose(uint32_t index, std::vector<uint32_t>& chosen)
+    {
+        _chosen[index] = 1;
+        chosen.push_back(index);
+    }
+
+    void Seeder::UpdateDistances(uint32_t index, bool first)
+    {
+        const int dimensions = _points.GetDimensions();
+        std::vector<double> center(dimensions);
+        _points.Gather(index, center.data());
+
+        _pool.ParallelFor(0, _blockCount, [&](size_t firstBlock, size_t lastBlock) {
+            static thread_local std::vector<double> distance;
+            for (size_t block = firstBlock; block < lastBlock; block++)
+            {
+                const size_t start = block * BlockPoints;
+                const size_t length = std::min(BlockPoints, _count - start);
+                distance.assign(length, 0.0);
+
+                // column by column, so the inner loop runs over contiguous values
+                for (int d = 0; d < dimensions; d++)
+                {
+                    const double* column = _points.Column(d) + start;
+                    const double coordinate = center[d];
+                    for (size_t i = 0; i < length; i++)
+                    {
+                        double diff = column[i] - coordinate;
+                        distance[i] += diff * diff;
+                    }
+                }
+
+                double* minDistance = _minDistance.data() + start;
+                double cost = 0.0;
+                for (size_t i = 0; i < length; i++)
+                {
+                    minDistance[i] = first ? distance[i] : std::min(minDistance[i], distance[i]);
+                    cost += minDistance[i];
+                }
+                _blockCost[block] = cost;
+            }
+        }, 1);
+    }
+
+    void Seeder::UpdateDistances(const std::vector<uint32_t>& indices, uint32_t firstCandidate)
+    {
+        const int dimensions = _points.GetDimensions();
+        CentroidSet centers;
+        centers.Resize((int)indices.size(), dimensions);
+        for (size_t c = 0; c < indices.size(); c++)
+        {
+            for (int d = 0; d < dimensions; d++) centers.Set((int)c, d, _points.At(indices[c], d));
+        }
+
+        _pool.ParallelFor(0, _blockCount, [&](size_t firstBlock, size_t lastBlock) {
+            static thread_local std::vector<double> point;
+            point.resize(dimensions);
+            for (size_t block = firstBlock; block < lastBlock; block++)
+            {
+                const size_t start = block * BlockPoints;
+                const size_t end = std::min(start + BlockPoints, _count);
+
+                double cost = 0.0;
+                for (size_t i = start; i < end; i++)
+                {
+                    _points.Gather(i, point.data());
+                    double distance;
+                    int nearest = _kernels.Nearest(point.data(), centers, distance);
+                    if (distance < _minDistance[i])
+                    {
+                        _minDistance[i] = distance;
+                        if (!_nearestCandidate.empty()) _nearestCandidate[i] = firstCandidate + nearest;
+                    }
+                    cost += _minDistance[i];
+                }
+                _blockCost[block] = cost;
+            }
+        }, 1);
+    }
+
+    uint32_t Seeder::DrawWeighted(double total)
+    {
+        if (total > 0.0)
+        {
+            double target = _random.Uniform() * total;
+            size_t last = _count;
+            for (size_t block = 0; block < _blockCount; block++)
+            {
+                const size_t start = block * BlockPoints;
+                const size_t end = std::min(start + BlockPoints, _count);
+                if (target >= _blockCost[block] && block + 1 < _blockCount)
+                {
+                    target -= _blockCost[block];
+                    continue;
+                }
+
+                for (size_t i = start; i < end; i++)
+                {
+                    if (_minDistance[i] <= 0.0) continue;
+                    last = i;
+                    if (target < _minDistance[i]) return (uint32_t)i;
+                    target -= _minDistance[i];
+                }
+                // rounding left the target past the block
+                if (last != _count) return (uint32_t)last;
+            }
+        }
+
+        // every point sits on a chosen one
+        uint64_t index = _random.Below(_count);
+        while (_chosen[index]) index = (index + 1) % _count;
+        return (uint32_t)index;
+    }
+
+    std::vector<uint32_t> Seeder::DrawRandom(uint32_t K)
+    {
+        std::vector<uint32_t> chosen;
+        while (chosen.size() < K)
+        {
+            uint32_t index = (uint32_t)_random.Below(_count);
+            if (!_chosen[index]) Choose(index, chosen);
+        }
+        return chosen;
+    }
+
+    void Seeder::CompletePlusPlus(uint32_t K, std::vector<uint32_t>& chosen)
+    {
+        while (chosen.size() < K)
+        {
+            uint32_t index = DrawWeighted(TotalCost());
+            Choose(index, chosen);
+            if (chosen.size() < K) UpdateDistances(index, false);
+        }
+    }
+
+    std::vector<uint32_t> Seeder::DrawPlusPlus(uint32_t K)
+    {
+        std::vector<uint32_t> chosen;
+        Choose((uint32_t)_random.Below(_count), chosen);
+        if (K > 1) UpdateDistances(chosen[0], true);
+        CompletePlusPlus(K, chosen);
+        return chosen;
+    }
+
+    std::vector<uint32_t> Seeder::DrawParallel(uint32_t K)
+    {
+        std::vector<uint32_t> candidates;
+        Choose((uint32_t)_random.Below(_count), candidates);
+        if (K == 1) return candidates;
+        UpdateDistances(candidates[0], true);
+        _nearestCandidate.assign(_count, 0);
+
+        const double oversampling = Oversampling * K;
+        std::vector<std::vector<uint32_t>> blockPicks(_blockCount);
+        for (int round = 0; round < ParallelRounds; round++)
+        {
+            const double total = TotalCost();
+            if (total <= 0.0) break;
+
+            _pool.ParallelFor(0, _blockCount, [&](size_t firstBlock, size_t lastBlock) {
+                for (size_t block = firstBlock; block < lastBlock; block++)
+                {
+                    Random random = BlockStream(_seed, round, block);
+                    const size_t start = block * BlockPoints;
+                    const size_t end = std::min(start + BlockPoints, _count);
+                    blockPicks[block].clear();
+                    for (size_t i = start; i < end; i++)
+                    {
+                        if (random.Uniform() * total < oversampling * _minDistance[i] && !_chosen[i]) blockPicks[block].push_back((uint32_t)i);
+                    }
+                }
+            }, 1);
+
+            std::vector<uint32_t> picks;
+            for (const std::vector<uint32_t>& block : blockPicks) picks.insert(picks.end(), block.begin(), block.end());
+            if (picks.empty()) continue;
+
+            const uint32_t firstCandidate = (uint32_t)candidates.size();
+            for (uint32_t index : picks) Choose(index, candidates);
+            UpdateDistances(picks, firstCandidate);
+        }
+
+        // too few candidates (tiny or degenerate inputs): the rest is drawn like k-means++
+        if (candidates.size() <= K)
+        {
+            CompletePlusPlus(K, candidates);
+            return candidates;
+        }
+
+        // weight of a candidate: the points nearest to it
+        const int dimensions = _points.GetDimensions();
+        const size_t candidateCount = candidates.size();
+        std::vector<double> coordinates(candidateCount * dimensions);
+        for (size_t c = 0; c < candidateCount; c++) _points.Gather(candidates[c], coordinates.data() + c * dimensions);
+
+        std::vector<std::atomic<uint64_t>> weights(candidateCount);
+        for (std::atomic<uint64_t>& weight : weights) weight.store(0, std::memory_order_relaxed);
+        _pool.ParallelFor(0, _count, [&](size_t start, size_t end) {
+            for (size_t i = start; i < end; i++) weights[_nearestCandidate[i]].fetch_add(1, std::memory_order_relaxed);
+        }, BlockPoints);
+
+        // weighted k-means++ over the candidates, the first one drawn by weight alone
+        std::vector<double> cost(candidateCount);
+        for (size_t c = 0; c < candidateCount; c++) cost[c] = (double)weights[c].load(std::memory_order_relaxed);
+        std::vector<double> minDistance(candidateCount, std::numeric_limits<double>::infinity());
+        std::vector<uint8_t> kept(candidateCount, 0);
+        std::vector<uint32_t> chosen;
+
+        while (chosen.size() < K)
+        {
+            double total = 0.0;
+            for (size_t c = 0; c < candidateCount; c++) total += kept[c] ? 0.0 : cost[c];
+
+            size_t pick = candidateCount;
+            double target = _random.Uniform() * total;
+            for (size_t c = 0; c < candidateCount && total > 0.0; c++)
+            {
+                if (kept[c] || cost[c] <= 0.0) continue;
+                pick = c;
+                if (target < cost[c]) break;
+                target -= cost[c];
+            }
+            // nothing left with weight: the first candidate not kept yet
+            if (pick == candidateCount) pick = std::find(kept.begin(), kept.end(), 0) - kept.begin();
+
+            kept[pick] = 1;
+            chosen.push_back(candidates[pick]);
+            if (chosen.size() == K) break;
+
+            const double* center = coordinates.data() + pick * dimensions;
+            _pool.ParallelFor(0, candidateCount, [&](size_t start, size_t end) {
+                for (size_t c = start; c < end; c++)
+                {
+                    const double* candidate = coordinates.data() + c * dimensions;
+                    double distance = 0.0;
+                    for (int d = 0; d < dimensions; d++)
+                    {
+                        double diff = candidate[d] - center[d];
+                        distance += diff * diff;
+                    }
+                    minDistance[c] = std::min(minDistance[c], distance);
+                    cost[c] = (double)weights[c].load(std::memory_order_relaxed) * minDistance[c];
+                }
+            });
+        }
+        return chosen;
+    }
+}
+
+bool ParseSeedingMethod(const std::string& name, SeedingMethod& method)
+{
+    if (name == "random") method = SeedingMethod::Random;
+    else if (name == "kmeans++") method = SeedingMethod::KMeansPlusPlus;
+    else if (name == "kmeans||") method = SeedingMethod::KMeansParallel;
+    else return false;
+    return true;
+}
+
+const char* SeedingMethodName(SeedingMethod method)
+{
+    switch (method)
+    {
+        case SeedingMethod::Random: return "random";
+        case SeedingMethod::KMeansPlusPlus: return "kmeans++";
+        case SeedingMethod::KMeansParallel: return "kmeans||";
+    }
+    return "unknown";
+}
+
+std::vector<uint32_t> SeedCentroids(const PointSet& points, uint32_t K, SeedingMethod method, uint64_t seed,
+                                    const DistanceKernels& kernels, ThreadPool& pool)
+{
+    if (K == 0 || K > points.GetCount()) return {};
+
+    Seeder seeder(points, seed, kernels, pool);
+    switch (method)
+    {
+        case SeedingMethod::Random: return seeder.DrawRandom(K);
+        case SeedingMethod::KMeansParallel: return seeder.DrawParallel(K);
+        default: return seeder.DrawPlusPlus(K);
+    }
+}
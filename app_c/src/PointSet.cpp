@@ -0,0 +1,16 @@
+#include "PointSet.hpp"
+
+#include <algorithm>
+
+void PointSet::Resize(size_t count, int dimensions)
+{
+    _count = count;
+    _stride = count;
+    _dimensions = dimensions;
+    _values.assign(count * dimensions, 0.0);
+}
+
+void PointSet::Truncate(size_t count)
+{
+    _count = std::min(count, _count);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// SplitMix64, small and cheap to seed, so every block of points can have its own stream
+class Random
+{
+    public:
+        explicit Random(uint64_t seed) : _state(seed) {}
+
+        uint64_t Next()
+        {
+            uint64_t z = (_state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // [0, 1)
+        double Uniform() { return (Next() >> 11) * 0x1.0p-53; }
+        // [0, count)
+        uint64_t Below(uint64_t count) { return Next() % count; }
+
+    private:
+        uint64_t _state;
+};
@@ -0,0 +1,261 @@
+#include "Silhouette.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+#include <ThreadPool.hpp>
+
+#include "Random.hpp"
+
+namespace
+{
+    // points whose distance sums are accumulated together, each tile is read once per row block
+    constexpr size_t RowBlock = 32;
+    // points of one cluster streamed per pass, 1024 x 8 coordinates stay in L1/L2 while the row block runs over them
+    constexpr size_t ColumnTile = 1024;
+    // chunks of the simplified silhouette, fixed so the sum doesn't depend on the thread count
+    constexpr size_t SimplifiedGrain = 16384;
+    // two sided 95% normal quantile
+    constexpr double ConfidenceZ = 1.959964;
+
+    // the points reordered cluster by cluster: cluster k holds the positions [Offsets[k], Offsets[k + 1])
+    struct SortedPoints {
+        PointSet Points;
+        std::vector<size_t> Offsets;
+        std::vector<int> Clusters;
+
+        size_t GetSize(int cluster) const { return Offsets[cluster + 1] - Offsets[cluster]; }
+    };
+
+    void SortByCluster(const PointSet& points, const std::vector<int>& assignments, int K, SortedPoints& sorted, ThreadPool& pool)
+    {
+        const size_t count = points.GetCount();
+        const int dimensions = points.GetDimensions();
+
+        sorted.Offsets.assign(K + 1, 0);
+        for (size_t i = 0; i < count; i++) sorted.Offsets[assignments[i] + 1]++;
+        for (int k = 0; k < K; k++) sorted.Offsets[k + 1] += sorted.Offsets[k];
+
+        std::vector<size_t> order(count);
+        std::vector<size_t> next(sorted.Offsets.begin(), sorted.Offsets.end() - 1);
+        sorted.Clusters.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t position = next[assignments[i]]++;
+            order[position] = i;
+            sorted.Clusters[position] = assignments[i];
+        }
+
+        sorted.Points.Resize(count, dimensions);
+        for (int d = 0; d < dimensions; d++)
+        {
+            const double* source = points.Column(d);
+            double* target = sorted.Points.Column(d);
+            pool.ParallelFor(0, count, [&](size_t start, size_t end) {
+                for (size_t i = start; i < end; i++) target[i] = source[order[i]];
+            });
+        }
+    }
+
+    // s of one point from its distance sums to every cluster (its own one includes the 0 to itself)
+    double PointSilhouette(const double* sums, int cluster, const SortedPoints& sorted, int K)
+    {
+        const size_t size = sorted.GetSize(cluster);
+        if (size <= 1) return 0.0;
+
+        const double a = sums[cluster] / (size - 1);
+        double b = std::numeric_limits<double>::infinity();
+        for (int k = 0; k < K; k++)
+        {
+            if (k == cluster || sorted.GetSize(k) == 0) continue;
+            b = std::min(b, sums[k] / sorted.GetSize(k));
+        }
+
+        const double largest = std::max(a, b);
+        return largest > 0.0 ? (b - a) / largest : 0.0;
+    }
+
+    // exact s of the sorted points at `positions`
+    void ExactValues(const SortedPoints& sorted, const std::vector<size_t>& positions, int K,
+                     const DistanceKernels& kernels, ThreadPool& pool, std::vector<double>& values)
+    {
+        const int dimensions = sorted.Points.GetDimensions();
+        const size_t stride = sorted.Points.GetStride();
+        const double* columns = sorted.Points.Column(0);
+        values.resize(positions.size());
+
+        const size_t blockCount = (positions.size() + RowBlock - 1) / RowBlock;
+        pool.ParallelFor(0, blockCount, [&](size_t firstBlock, size_t lastBlock) {
+            static thread_local std::vector<double> rows;
+            static thread_local std::vector<double> sums;
+            rows.resize(RowBlock * dimensions);
+            sums.resize(RowBlock * K);
+
+            for (size_t block = firstBlock; block < lastBlock; block++)
+            {
+                const size_t first = block * RowBlock;
+                const size_t rowCount = std::min(RowBlock, positions.size() - first);
+                for (size_t r = 0; r < rowCount; r++) sorted.Points.Gather(positions[first + r], rows.data() + r * dimensions);
+                std::fill(sums.begin(), sums.begin() + rowCount * K, 0.0);
+
+                for (int k = 0; k < K; k++)
+                {
+                    for (size_t tile = sorted.Offsets[k]; tile < sorted.Offsets[k + 1]; tile += ColumnTile)
+                    {
+                        const size_t length = std::min(ColumnTile, sorted.Offsets[k + 1] - tile);
+                        for (size_t r = 0; r < rowCount; r++)
+                        {
+                            sums[r * K + k] += kernels.DistanceSum(rows.data() + r * dimensions, columns + tile, stride, dimensions, length);
+                        }
+                    }
+                }
+
+                for (size_t r = 0; r < rowCount; r++)
+                {
+                    values[first + r] = PointSilhouette(sums.data() + r * K, sorted.Clusters[positions[first + r]], sorted, K);
+                }
+            }
+        }, 1);
+    }
+
+    double Sum(const std::vector<double>& values)
+    {
+        double sum = 0.0;
+        for (double value : values) sum += value;
+        return sum;
+    }
+
+    double SimplifiedSilhouette(const PointSet& points, const std::vector<int>& assignments, const CentroidSet& centroids,
+                                const std::vector<size_t>& sizes, const DistanceKernels& kernels, ThreadPool& pool)
+    {
+        const int K = centroids.GetCount();
+        const int dimensions = points.GetDimensions();
+
+        double sum = pool.ParallelReduce(0, points.GetCount(), 0.0,
+            [&](size_t start, size_t end) {
+                std::vector<double> point(dimensions);
+                std::vector<double> distances(centroids.GetStride());
+                double partial = 0.0;
+                for (size_t i = start; i < end; i++)
+                {
+                    const int cluster = assignments[i];
+                    if (sizes[cluster] <= 1) continue;
+
+                    points.Gather(i, point.data());
+                    kernels.Distances(point.data(), centroids, distances.data());
+
+                    const double a = std::sqrt(distances[cluster]);
+                    double b = std::numeric_limits<double>::infinity();
+                    for (int k = 0; k < K; k++)
+                    {
+                        if (k != cluster && sizes[k] > 0) b = std::min(b, distances[k]);
+                    }
+                    b = std::sqrt(b);
+
+                    const double largest = std::max(a, b);
+                    if (largest > 0.0) partial += (b - a) / largest;
+                }
+                return partial;
+            },
+            [](double lhs, double rhs) { return lhs + rhs; }, SimplifiedGrain);
+
+        return sum / points.GetCount();
+    }
+
+    // `samples` distinct positions out of `count` (Floyd's algorithm), ascending
+    std::vector<size_t> DrawSample(size_t count, size_t samples, uint64_t seed)
+    {
+        Random random(seed);
+        std::unordered_set<size_t> drawn;
+        drawn.reserve(samples * 2);
+        for (size_t j = count - samples; j < count; j++)
+        {
+            size_t candidate = random.Below(j + 1);
+            drawn.insert(drawn.count(candidate) ? j : candidate);
+        }
+
+        std::vector<size_t> positions(drawn.begin(), drawn.end());
+        std::sort(positions.begin(), positions.end());
+        return positions;
+    }
+}
+
+bool ParseSilhouetteMethod(const std::string& name, SilhouetteMethod& method)
+{
+    if (name == "auto") method = SilhouetteMethod::Auto;
+    else if (name == "exact") method = SilhouetteMethod::Exact;
+    else if (name == "simplified") method = SilhouetteMethod::Simplified;
+    else if (name == "sampled") method = SilhouetteMethod::Sampled;
+    else if (name == "none") method = SilhouetteMethod::None;
+    else return false;
+    return true;
+}
+
+const char* SilhouetteMethodName(SilhouetteMethod method)
+{
+    switch (method)
+    {
+        case SilhouetteMethod::Auto: return "auto";
+        case SilhouetteMethod::Exact: return "exact";
+        case SilhouetteMethod::Simplified: return "simplified";
+        case SilhouetteMethod::Sampled: return "sampled";
+        case SilhouetteMethod::None: return "none";
+    }
+    return "unknown";
+}
+
+SilhouetteResult ComputeSilhouette(const PointSet& points, const std::vector<int>& assignments, const CentroidSet& centroids,
+                                   SilhouetteMethod method, size_t samples, uint64_t seed,
+                                   const DistanceKernels& kernels, ThreadPool& pool)
+{
+    const size_t count = points.GetCount();
+    const int K = centroids.GetCount();
+
+    SilhouetteResult result;
+    if (method == SilhouetteMethod::Auto) method = count <= ExactSilhouetteMaxPoints ? SilhouetteMethod::Exact : SilhouetteMethod::Sampled;
+    // a sample of every point is the exact value
+    if (method == SilhouetteMethod::Sampled && samples >= count) method = SilhouetteMethod::Exact;
+    result.Method = method;
+    if (method == SilhouetteMethod::None || count == 0) return result;
+
+    std::vector<size_t> sizes(K, 0);
+    for (size_t i = 0; i < count; i++) sizes[assignments[i]]++;
+    if (std::count_if(sizes.begin(), sizes.end(), [](size_t size) { return size > 0; }) < 2) return result;
+    result.Valid = true;
+
+    if (method == SilhouetteMethod::Simplified)
+    {
+        result.Value = SimplifiedSilhouette(points, assignments, centroids, sizes, kernels, pool);
+        return result;
+    }
+
+    SortedPoints sorted;
+    SortByCluster(points, assignments, K, sorted, pool);
+
+    std::vector<size_t> positions;
+    if (method == SilhouetteMethod::Exact)
+    {
+        positions.resize(count);
+        for (size_t i = 0; i < count; i++) positions[i] = i;
+    }
+    else positions = DrawSample(count, std::max<size_t>(samples, 2), seed);
+
+    std::vector<double> values;
+    ExactValues(sorted, positions, K, kernels, pool, values);
+    result.Value = Sum(values) / values.size();
+
+    if (method == SilhouetteMethod::Sampled)
+    {
+        // sample standard deviation with the finite population correction
+        double squares = 0.0;
+        for (double value : values) squares += (value - result.Value) * (value - result.Value);
+        const double n = (double)values.size();
+        const double deviation = std::sqrt(squares / (n - 1.0));
+        const double correction = std::sqrt((double)(count - values.size()) / (double)(count - 1));
+        result.Samples = values.size();
+        result.Margin = ConfidenceZ * deviation / std::sqrt(n) * correction;
+    }
+    return result;
+}
@@ -20,68 +20,126 @@ bool OptionExists(char** begin, char** end, const std::string& option)
     return std::find(begin, end, option) != end;
 }
 
-void SeperateXandY(std::vector<Point>& points, std::vector<double>& x, std::vector<double>& y)
+// first two coordinates of the cluster points, what the plot shows
+void SeperateXandY(const PointSet& points, const std::vector<uint32_t>& members, std::vector<double>& x, std::vector<double>& y)
 {
-    uint32_t size = points.size();
+    uint32_t size = members.size();
 
     x.resize(size);
     y.resize(size);
 
     for (int i = 0; i < size; i++)
     {
-        Point& point = points[i];
-        x[i] = point.X;
-        y[i] = point.Y; 
+        x[i] = points.At(members[i], 0);
+        y[i] = points.At(members[i], points.GetDimensions() > 1 ? 1 : 0);
     }
 }
 
+// "a,b,c" -> { "a", "b", "c" }
+std::vector<std::string> SplitColumns(const std::string& list)
+{
+    std::vector<std::string> columns;
+    size_t start = 0;
+    while (true)
+    {
+        size_t end = list.find(',', start);
+        columns.push_back(list.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    return columns;
+}
+
 int main(int argc, char* argv[]){
 
     std::string inputFilename = "csv/BD-Patients.csv";
     std::string xColumn = "Creatinine_pvariance";
     std::string yColumn = "HCO3_mean";
-    uint32_t maxVectorCount = 5000;
+    std::string columnList;
+    uint32_t maxVectorCount = 0;
     uint32_t K = 3;
     uint8_t numThreads = 3; 
     std::string outputFilename = "None";
+    bool useCache = true;
+    ClusteringOptions options;
+    std::string statsFilename;
     
     if (OptionExists(argv, argv+argc, "-h"))
     {
-        std::cout << "Usage: app_c.exe [--csv input.csv] [--x name] [--y name] [--max uint] [--K uint] [--thrCount uint] [--outSVG out.svg]";
+        std::cout << "Usage: app_c.exe [--csv input.csv] [--x name] [--y name] [--columns name,name,...] [--max uint] [--K uint] [--thrCount uint] [--outSVG out.svg] [--noCache] [--maxIter uint] [--tol float] [--iterStats stats.csv] [--init random|kmeans++|kmeans||] [--seed uint] [--assign lloyd|hamerly|elkan] [--search auto|brute|kdtree] [--silhouette auto|exact|simplified|sampled|none] [--samples uint]";
         return EXIT_FAILURE;
     }
 
     if (OptionExists(argv, argv+argc, "--csv")) inputFilename = GetOption(argv, argv + argc, "--csv");
     if (OptionExists(argv, argv+argc, "--x")) xColumn = GetOption(argv, argv + argc, "--x");
     if (OptionExists(argv, argv+argc, "--y")) yColumn = GetOption(argv, argv + argc, "--y");
+    if (OptionExists(argv, argv+argc, "--columns")) columnList = GetOption(argv, argv + argc, "--columns");
     if (OptionExists(argv, argv+argc, "--max")) maxVectorCount = std::stoi(GetOption(argv, argv + argc, "--max"));
     if (OptionExists(argv, argv+argc, "--K")) K = std::stoi(GetOption(argv, argv + argc, "--K"));
     if (OptionExists(argv, argv+argc, "--thrCount")) numThreads = std::stoi(GetOption(argv, argv + argc, "--thrCount"));
     if (OptionExists(argv, argv+argc, "--outSVG")) outputFilename = GetOption(argv, argv + argc, "--outSVG");
+    if (OptionExists(argv, argv+argc, "--noCache")) useCache = false;
+    if (OptionExists(argv, argv+argc, "--maxIter")) options.MaxIterations = std::stoi(GetOption(argv, argv + argc, "--maxIter"));
+    if (OptionExists(argv, argv+argc, "--tol")) options.Tolerance = std::stod(GetOption(argv, argv + argc, "--tol"));
+    if (OptionExists(argv, argv+argc, "--seed")) options.Seed = std::stoull(GetOption(argv, argv + argc, "--seed"));
+    if (OptionExists(argv, argv+argc, "--init") && !ParseSeedingMethod(GetOption(argv, argv + argc, "--init"), options.Seeding))
+    {
+        std::cout << "Unknown --init method, expected random, kmeans++ or kmeans||" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (OptionExists(argv, argv+argc, "--assign") && !ParseAssignmentMethod(GetOption(argv, argv + argc, "--assign"), options.Assignment))
+    {
+        std::cout << "Unknown --assign method, expected lloyd, hamerly or elkan" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (OptionExists(argv, argv+argc, "--search") && !ParseCentroidSearch(GetOption(argv, argv + argc, "--search"), options.Search))
+    {
+        std::cout << "Unknown --search method, expected auto, brute or kdtree" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (OptionExists(argv, argv+argc, "--silhouette") && !ParseSilhouetteMethod(GetOption(argv, argv + argc, "--silhouette"), options.Silhouette))
+    {
+        std::cout << "Unknown --silhouette method, expected auto, exact, simplified, sampled or none" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (OptionExists(argv, argv+argc, "--samples")) options.SilhouetteSamples = std::stoull(GetOption(argv, argv + argc, "--samples"));
+    if (OptionExists(argv, argv+argc, "--iterStats")) statsFilename = GetOption(argv, argv + argc, "--iterStats");
+
+    if (options.MaxIterations == 0 || !(options.Tolerance >= 0.0) || options.SilhouetteSamples < 2)
+    {
+        std::cout << "--maxIter must be at least 1, --tol not negative and --samples at least 2" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // --columns replaces --x and --y
+    std::vector<std::string> columns = columnList.empty() ? std::vector<std::string>{ xColumn, yColumn } : SplitColumns(columnList);
 
     std::cout << "Parameters: " <<
         inputFilename << "; " <<
-        xColumn << "; " <<
-        yColumn << "; " <<
+        (columnList.empty() ? xColumn + "; " + yColumn : columnList) << "; " <<
         maxVectorCount << "; " <<
         K << "; " <<
         numThreads << "; " <<
         outputFilename << std::endl;
 
-    CsvProcessor* processor = new CsvProcessor(inputFilename, xColumn, yColumn, maxVectorCount);
+    CsvProcessor* processor = new CsvProcessor(inputFilename, columns, maxVectorCount, numThreads, useCache);
 
     if (!processor->GetIsReady()) return EXIT_FAILURE;
 
-    processor->PerformClusterization(K, numThreads);
+    if (!processor->PerformClusterization(K, numThreads, options)) return EXIT_FAILURE;
+    if (!statsFilename.empty() && !processor->SaveIterationStats(statsFilename)) return EXIT_FAILURE;
 
     std::vector clusters = processor->GetCluseters();
 
     std::cout << "---------------------------------------------------------" << std::endl;
     std::cout << "Cluster centroids info" << std::endl;
+    std::string centroidLabel;
+    for (const std::string& column : processor->GetGraphInfo().Labels) centroidLabel += (centroidLabel.empty() ? "" : ", ") + column;
     for (auto cluster = clusters.begin(); cluster != clusters.end(); cluster++)
     {   
-        Point centroid = cluster->Centroid;
-        std::cout << "Cluster id: " << cluster->Id << "; Centroid (x, y): " << centroid.X << "; " << centroid.Y << "; " << std::endl;
+        std::cout << "Cluster id: " << cluster->Id << "; Centroid (" << centroidLabel << "): ";
+        for (double coordinate : cluster->Centroid) std::cout << coordinate << "; ";
+        std::cout << std::endl;
     }
     std::cout << "---------------------------------------------------------" << std::endl;
 
@@ -92,7 +150,7 @@ int main(int argc, char* argv[]){
     {   
         std::vector<double> x, y;
 
-        SeperateXandY(cluster->Points, x, y);
+        SeperateXandY(processor->GetPoints(), cluster->Points, x, y);
         plt.scatter(x, y);
     }
 
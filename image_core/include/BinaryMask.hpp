@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 1 bit per pixel, every row is a run of 64-bit words: pixel x is bit x % 64 of word x / 64.
+// Word operations handle 64 pixels at once; bits past the width in the last word of a row stay 0.
+class BinaryMask
+{
+    public:
+        static constexpr int WordBits = 64;
+
+        static int WordCount(int width) { return (width + WordBits - 1) / WordBits; }
+
+        BinaryMask() = default;
+        BinaryMask(int width, int height) { Resize(width, height); }
+
+        // every bit is cleared, storage is reused when it is large enough
+        void Resize(int width, int height);
+
+        int GetWidth() const { return _width; }
+        int GetHeight() const { return _height; }
+        int GetWordsPerRow() const { return _wordsPerRow; }
+        size_t GetSizeBytes() const { return _words.size() * sizeof(uint64_t); }
+
+        uint64_t* Row(int y) { return _words.data() + (size_t)y * _wordsPerRow; }
+        const uint64_t* Row(int y) const { return _words.data() + (size_t)y * _wordsPerRow; }
+
+        bool Get(int x, int y) const { return (Row(y)[x / WordBits] >> (x % WordBits)) & 1; }
+
+        // flips every pixel, the bits past the width stay 0
+        void Invert();
+
+        // clears the bits past the width, for word operations that fill whole words
+        void ClearPadding();
+
+    private:
+        int _width = 0;
+        int _height = 0;
+        int _wordsPerRow = 0;
+        std::vector<uint64_t> _words;
+};
+
+// Word `word` of a mask row seen `offset` pixels further along the row:
+// bit i holds pixel 64 * word + i + offset, pixels outside the row read as 0.
+inline uint64_t ShiftedWord(const uint64_t* row, int wordsPerRow, int word, int offset)
+{
+    int shift = offset % BinaryMask::WordBits;
+    int source = word + offset / BinaryMask::WordBits;
+    if (shift < 0)
+    {
+        shift += BinaryMask::WordBits;
+        source--;
+    }
+
+    uint64_t low = source >= 0 && source < wordsPerRow ? row[source] : 0;
+    if (shift == 0) return low;
+
+    uint64_t high = source + 1 >= 0 && source + 1 < wordsPerRow ? row[source + 1] : 0;
+    return (low >> shift) | (high << (BinaryMask::WordBits - shift));
+}
+
+// Packs `count` pixels into mask bits: bit i is set when values[i * pixelStep] > threshold
+void PackThreshold(const uint8_t* values, int pixelStep, int count, int threshold, uint64_t* words);
+
+// Writes `count` pixels of mask bits as bytes: set bits become `one`, cleared bits `zero`
+void ExpandMaskBits(const uint64_t* words, int count, uint8_t zero, uint8_t one, uint8_t* dst);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BinaryMask.hpp"
+
+class ThreadPool;
+
+struct ComponentStats {
+    uint64_t Area = 0;
+    int MinX = 0, MinY = 0, MaxX = 0, MaxY = 0;
+    // sums of the pixel coordinates, the centroid is Sum / Area
+    uint64_t SumX = 0, SumY = 0;
+
+    double CentroidX() const { return Area ? (double)SumX / Area : 0; }
+    double CentroidY() const { return Area ? (double)SumY / Area : 0; }
+};
+
+// Labels the set pixels of mask into 4- or 8-connected components, numbered in the scan order of their first pixel.
+// Works on runs of set pixels: every strip of rows extracts its runs and joins the overlapping runs of consecutive rows
+// in parallel, then the strip borders are joined through a lock-free union-find, so no per-pixel label image is kept.
+std::vector<ComponentStats> LabelComponents(const BinaryMask& mask, int connectivity = 8, ThreadPool* pool = nullptr);
+
+// label,area,min_x,min_y,max_x,max_y,centroid_x,centroid_y with labels from 1
+bool WriteComponentsCsv(const std::string& filename, const std::vector<ComponentStats>& components);
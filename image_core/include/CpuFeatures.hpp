@@ -0,0 +1,13 @@
+#pragma once
+
+enum class SimdLevel {
+    Scalar = 0,
+    Sse41 = 1,
+    Avx2 = 2
+};
+
+// Best level supported by both the build and the running CPU.
+// IMAGE_CORE_SIMD=scalar|sse4|avx2 in the environment lowers it (useful for comparing paths).
+SimdLevel GetSimdLevel();
+
+const char* SimdLevelName(SimdLevel level);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Inputs of a batch run: the image files of a directory sorted by name,
+// or the lines of a list file (empty lines and lines starting with '#' are skipped).
+// False (and a message on stdout) when the source can't be read or two inputs share a file name without extension,
+// as they would be saved to the same BatchOutputPath.
+bool CollectBatchInputs(const std::string& source, std::vector<std::string>& files);
+
+// creates outputDirectory when missing, false (and a message on stderr) when it can't be created
+bool PrepareBatchOutput(const std::string& outputDirectory);
+
+// outputDirectory/<input file name without extension><extension>
+std::string BatchOutputPath(const std::string& outputDirectory, const std::string& inputFile, const std::string& extension = ".bmp");
+
+// one image loading, one processed, one saving and a spare so the loader can run ahead
+constexpr int BatchSlotCount = 4;
+
+// Every image of inputSource goes through load -> process -> save as overlapping stages (see RunPipeline),
+// each stage gets the slot in [0, BatchSlotCount) whose buffers hold its image so they are recycled between images.
+// load gets the input file, save the BatchOutputPath with `extension`; a failed load skips the image.
+// Prints the image count and the elapsed time, true when every image was saved
+bool RunImageBatch(const std::string& inputSource, const std::string& outputDirectory, const std::string& extension, int numThreads,
+                   const std::function<bool(const std::string& file, int slot)>& load,
+                   const std::function<void(int slot)>& process,
+                   const std::function<bool(const std::string& file, int slot)>& save);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "ImageView.hpp"
+
+class ThreadPool;
+
+// Planar 8-bit image: every channel is stored as its own plane,
+// rows are padded to a multiple of RowAlignment bytes.
+class ImageBuffer
+{
+    public:
+        static constexpr size_t RowAlignment = 64;
+
+        ImageBuffer() = default;
+        ImageBuffer(int width, int height, int channels);
+
+        // reallocates only when the new image does not fit the current storage, pixels are left uninitialized
+        void Resize(int width, int height, int channels);
+
+        int GetWidth() const { return _width; }
+        int GetHeight() const { return _height; }
+        int GetChannels() const { return _channels; }
+        // distance between two rows of a plane in bytes
+        size_t GetStride() const { return _stride; }
+        bool IsEmpty() const { return _width == 0 || _height == 0; }
+
+        uint8_t* Plane(int channel) { return _planes + channel * _planeSize; }
+        const uint8_t* Plane(int channel) const { return _planes + channel * _planeSize; }
+
+        uint8_t* Row(int channel, int y) { return Plane(channel) + y * _stride; }
+        const uint8_t* Row(int channel, int y) const { return Plane(channel) + y * _stride; }
+
+        ConstImageView View(int channel) const { return { Plane(channel), _width, _height, (ptrdiff_t)_stride, 1 }; }
+
+        // one plane per view, all views have the same size; rows are split over `pool` when given
+        void CopyFrom(const ConstImageView* channelViews, int channels, ThreadPool* pool = nullptr);
+        // data holds width * height pixels of `channels` interleaved bytes (stb layout)
+        void FromInterleaved(const unsigned char* data, int width, int height, int channels);
+
+    private:
+        int _width = 0;
+        int _height = 0;
+        int _channels = 0;
+        size_t _stride = 0;
+        size_t _planeSize = 0;
+
+        std::unique_ptr<uint8_t[]> _storage;
+        size_t _capacity = 0;
+        uint8_t* _planes = nullptr;
+};
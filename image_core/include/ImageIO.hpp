@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <MappedFile.hpp>
+
+#include "BinaryMask.hpp"
+#include "ImageBuffer.hpp"
+#include "ImageView.hpp"
+
+class ThreadPool;
+class PngEncoder;
+
+// 8-bit pixels exactly as they are stored in the file or returned by the decoder.
+// Processors that read every input pixel once can work on Channel() views without a planar copy.
+class DecodedImage
+{
+    public:
+        // Uncompressed 24/32-bit BMP files are mapped and read in place, anything else goes through stb_image.
+        // False (and a message on stdout) when the file can't be read.
+        bool Load(const std::string& filename, int channels = 3);
+        void Release();
+
+        bool IsEmpty() const { return !_pixels; }
+        int GetWidth() const { return _width; }
+        int GetHeight() const { return _height; }
+        int GetChannels() const { return _channels; }
+        // channel count stored in the file
+        int GetSourceChannels() const { return _sourceChannels; }
+
+        // channels are in RGB(A) order whatever the order in the file
+        ConstImageView Channel(int channel) const
+        {
+            int offset = _bgr && channel < 3 ? 2 - channel : channel;
+            return { _pixels + offset, _width, _height, _rowStride, _pixelStep };
+        }
+
+    private:
+        bool MapBmp(const std::string& filename, int channels);
+
+    private:
+        struct DecoderFree {
+            void operator()(unsigned char* data) const;
+        };
+
+        std::unique_ptr<unsigned char, DecoderFree> _data;
+        MappedFile _file;
+
+        // first byte of the top row, rows of a bottom-up BMP have a negative stride
+        const uint8_t* _pixels = nullptr;
+        ptrdiff_t _rowStride = 0;
+        int _pixelStep = 0;
+        bool _bgr = false;
+
+        int _width = 0;
+        int _height = 0;
+        int _channels = 0;
+        int _sourceChannels = 0;
+};
+
+// Decodes into planar storage, rows are split over `pool` when given.
+// The mapping or decoder output is released before returning.
+bool LoadImage(const std::string& filename, ImageBuffer& image, int channels = 3, int* sourceChannels = nullptr, ThreadPool* pool = nullptr);
+
+// 24-bit BMP encoded from the planes straight into the mapped output file, rows are split over `pool` when given.
+// A single plane is written as gray.
+bool SaveBmp(const std::string& filename, const ImageBuffer& image, ThreadPool* pool = nullptr);
+
+// Reads an uncompressed 24/32-bit BMP one band of rows at a time, for images that don't fit in memory.
+// Only the current band is held: the raw file rows and the planes they are split into.
+class BmpBandReader
+{
+    public:
+        BmpBandReader() = default;
+        ~BmpBandReader() { Close(); }
+
+        BmpBandReader(const BmpBandReader&) = delete;
+        BmpBandReader& operator=(const BmpBandReader&) = delete;
+
+        // false (and a message on stdout) when the file can't be read or is in another format
+        bool Open(const std::string& filename);
+        void Close();
+
+        int GetWidth() const { return _width; }
+        int GetHeight() const { return _height; }
+        int GetSourceChannels() const { return _bitsPerPixel / 8; }
+
+        // image rows [firstRow, firstRow + rowCount) into the first `channels` RGB planes of band
+        bool ReadRows(int firstRow, int rowCount, ImageBuffer& band, int channels = 3, ThreadPool* pool = nullptr);
+
+    private:
+        std::FILE* _file = nullptr;
+        int _width = 0;
+        int _height = 0;
+        int _bitsPerPixel = 0;
+        bool _topDown = false;
+        size_t _dataOffset = 0;
+        size_t _rowSize = 0;
+        std::vector<uint8_t> _raw;
+};
+
+// Writes a 24-bit BMP band by band in any order, the rows of a band are encoded over `pool` when given
+class BmpBandWriter
+{
+    public:
+        BmpBandWriter() = default;
+        ~BmpBandWriter() { Close(); }
+
+        BmpBandWriter(const BmpBandWriter&) = delete;
+        BmpBandWriter& operator=(const BmpBandWriter&) = delete;
+
+        // writes the header, false (and a message on stderr) when the file can't be created
+        bool Open(const std::string& filename, int width, int height);
+        // false when a write failed since Open
+        bool Close();
+
+        // band rows become image rows [firstRow, firstRow + band height)
+        bool WriteRows(int firstRow, const ImageBuffer& band, ThreadPool* pool = nullptr);
+
+    private:
+        std::FILE* _file = nullptr;
+        bool _failed = false;
+        int _width = 0;
+        int _height = 0;
+        size_t _rowSize = 0;
+        std::vector<uint8_t> _raw;
+};
+
+// File formats a binary mask is written in, every pixel becomes one of two gray levels:
+// Bmp24 is the plain 24-bit BMP, Bmp1 a 1-bit BMP with the two levels as palette,
+// Pbm a binary (P4) PBM where the darker level is black and Png an 8-bit grayscale PNG
+enum class MaskFormat { Bmp24, Bmp1, Pbm, Png };
+
+// "bmp", "bmp1", "pbm" or "png", false (and a message on stdout) for anything else
+bool ParseMaskFormat(const std::string& name, MaskFormat& format);
+// from the extension of filename: .pbm and .png, anything else is Bmp24
+MaskFormat MaskFormatFromFilename(const std::string& filename);
+// ".bmp", ".pbm" or ".png"
+const char* MaskFormatExtension(MaskFormat format);
+
+// Writes a binary mask band by band straight from its bits, only the rows of the current band are encoded at a time.
+// Set bits become `one` and cleared bits `zero`. Bands have to come top to bottom, the BMP rows are
+// placed bottom-up with a seek per band.
+class MaskWriter
+{
+    public:
+        MaskWriter();
+        ~MaskWriter();
+
+        MaskWriter(const MaskWriter&) = delete;
+        MaskWriter& operator=(const MaskWriter&) = delete;
+
+        // writes the header, false (and a message on stderr) when the file can't be created
+        bool Open(const std::string& filename, int width, int height, MaskFormat format, uint8_t zero, uint8_t one);
+        // false when a write failed or rows are missing
+        bool Close();
+
+        // mask rows [firstMaskRow, firstMaskRow + rowCount) become the next image rows,
+        // BMP and PBM rows are encoded over `pool` when given
+        bool WriteRows(const BinaryMask& mask, int firstMaskRow, int rowCount, ThreadPool* pool = nullptr);
+
+    private:
+        void EncodeRow(const uint64_t* words, uint8_t* dst) const;
+
+    private:
+        std::FILE* _file = nullptr;
+        bool _failed = false;
+        MaskFormat _format = MaskFormat::Bmp24;
+        uint8_t _zero = 0;
+        uint8_t _one = 0;
+        int _width = 0;
+        int _height = 0;
+        int _nextRow = 0;
+        size_t _rowSize = 0;
+        size_t _dataOffset = 0;
+        std::vector<uint8_t> _raw;
+        std::unique_ptr<PngEncoder> _png;
+};
+
+// The whole mask through a MaskWriter
+bool SaveMask(const std::string& filename, const BinaryMask& mask, MaskFormat format, uint8_t zero, uint8_t one, ThreadPool* pool = nullptr);
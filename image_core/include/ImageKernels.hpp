@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CpuFeatures.hpp"
+
+// Integer convolution weights, Width * Height values stored row by row.
+// The anchor pixel is (Width / 2, Height / 2).
+struct ConvolutionTaps {
+    int Width;
+    int Height;
+    const int* Weights;
+    int WeightSum;   // divisor, never 0
+};
+
+// Convolves pixels [startX, endX) of row y of a single plane into dstRow[startX, endX).
+// Every tap has to be inside the plane: the caller handles the image border.
+using ConvolveRowFunction = void (*)(const ConvolutionTaps& taps, const uint8_t* src, size_t srcStride, int y,
+                                     uint8_t* dstRow, int startX, int endX);
+
+// dst[i] = (a[2i] + a[2i + 1] + b[2i] + b[2i + 1]) / 4 for i in [0, count)
+using Downscale2xRowFunction = void (*)(const uint8_t* rowA, const uint8_t* rowB, uint8_t* dst, int count);
+
+struct ImageKernels {
+    SimdLevel Level;
+    ConvolveRowFunction ConvolveRow;
+    Downscale2xRowFunction Downscale2xRow;
+};
+
+// Kernels for GetSimdLevel(), resolved once
+const ImageKernels& GetImageKernels();
+
+// SIMD convolution accumulates in 16 bits: true when no weighted sum of 8-bit pixels can overflow it
+bool FitsInt16Accumulator(const ConvolutionTaps& taps);
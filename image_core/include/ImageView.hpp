@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Non-owning view of one 8-bit channel: pixel (x, y) is Data[y * RowStride + x * PixelStep].
+// PixelStep is 1 for a plane of an ImageBuffer and the channel count for interleaved decoder output.
+struct ConstImageView {
+    const uint8_t* Data = nullptr;
+    int Width = 0;
+    int Height = 0;
+    ptrdiff_t RowStride = 0;
+    int PixelStep = 1;
+
+    const uint8_t* Row(int y) const { return Data + y * RowStride; }
+    uint8_t At(int x, int y) const { return Row(y)[x * PixelStep]; }
+    bool IsPlanar() const { return PixelStep == 1; }
+
+    // channel `channel` of width * height interleaved pixels with `channels` bytes each
+    static ConstImageView Interleaved(const uint8_t* data, int width, int height, int channels, int channel)
+    {
+        return { data + channel, width, height, (ptrdiff_t)width * channels, channels };
+    }
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "BinaryMask.hpp"
+#include "StructuringElement.hpp"
+
+// How a 1D running OR over a window of `length` pixels is computed on mask words:
+// Shift ORs `length` shifted copies of every word, VanHerk (van Herk / Gil-Werman) ORs a block prefix and
+// a block suffix, a constant amount of work per word whatever the length. Auto picks Shift for short windows.
+enum class MorphologyMethod { Auto, Shift, VanHerk };
+
+const char* MorphologyMethodName(MorphologyMethod method);
+
+// Bit i of dst[word] is the OR of row pixels [x - before, x + after], x = x0 + 64 * word + i,
+// for wordCount words. Pixels outside the row (wordsPerRow words) read as 0.
+void DilateRowSpan(const uint64_t* row, int wordsPerRow, int x0, int wordCount, int before, int after,
+                   uint64_t* dst, MorphologyMethod method = MorphologyMethod::Auto);
+
+// Row r of dst, for r in [firstOut, firstOut + outCount), is the OR of rows [r - before, r + after] of src,
+// src holds rowCount rows of wordCount words `srcStride` words apart, rows outside it read as 0.
+// dst row r is stored at dst + (r - firstOut) * dstStride.
+void DilateColumnSpan(const uint64_t* src, size_t srcStride, int rowCount, int wordCount, int before, int after,
+                      int firstOut, int outCount, uint64_t* dst, size_t dstStride, MorphologyMethod method = MorphologyMethod::Auto);
+
+// dst(x, y) is the OR of src(x + offsetX + dx, y + offsetY + dy) over the cells (dx, dy) of element around its origin,
+// pixels outside src read as 0; dst keeps its size. Every row of the element is split into runs of set cells,
+// each run is a row dilation followed by column dilations over the element rows sharing it, so a square costs
+// one row and one column pass and a disc one per distinct run width.
+void WindowOr(const BinaryMask& src, int offsetX, int offsetY, const StructuringElement& element, BinaryMask& dst,
+              MorphologyMethod method = MorphologyMethod::Auto);
+
+// Erosion keeps the pixels whose element placed on them lies inside the foreground, pixels outside src count as foreground.
+// Dilation sets the pixels the reflected element placed on them touches the foreground with.
+// dst(x, y) corresponds to src(x + offsetX, y + offsetY). Erode inverts src in place and back.
+void ErodeMask(BinaryMask& src, int offsetX, int offsetY, const StructuringElement& element, BinaryMask& dst,
+               MorphologyMethod method = MorphologyMethod::Auto);
+void DilateMask(const BinaryMask& src, int offsetX, int offsetY, const StructuringElement& element, BinaryMask& dst,
+                MorphologyMethod method = MorphologyMethod::Auto);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary structuring element, cells stored row by row. Cell (x, y) sits (x - OriginX, y - OriginY) away from the origin.
+struct StructuringElement {
+    std::string Name = "None";
+    int Width = 0;
+    int Height = 0;
+    int OriginX = 0;
+    int OriginY = 0;
+    std::vector<uint8_t> Cells;
+
+    bool At(int x, int y) const { return Cells[y * Width + x] != 0; }
+
+    bool IsEmpty() const;
+
+    // mirrored through the origin, dilation by an element is a window OR over its reflection
+    StructuringElement Reflected() const;
+};
+
+// size x size elements with the origin at ((size - 1) / 2, (size - 1) / 2)
+StructuringElement MakeSquareElement(int size);
+StructuringElement MakeCrossElement(int size);
+StructuringElement MakeDiscElement(int size);
+
+// Text file, one element row per line, cells 0/1 optionally separated by spaces or commas, '#' starts a comment.
+// The origin is the center cell (rounded towards the top left for even sizes).
+bool LoadStructuringElement(const std::string& filename, StructuringElement& element);
+
+// "5" (square), "square5", "cross5", "disc5" or a path to an element file
+bool ResolveStructuringElement(const std::string& spec, StructuringElement& element);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ImageBuffer.hpp"
+#include "ImageView.hpp"
+
+class ThreadPool;
+
+// Summed-area table of one 8-bit plane: At(x, y) is the sum of the pixels in [0, x) x [0, y),
+// so the sum over any box costs four lookups whatever its size.
+// Built in two parallel passes: prefix sums along every row, then running sums down column bands.
+// Sums are kept modulo 2^32: a box sum is still exact while the box has at most MaxBoxArea pixels.
+class SummedAreaTable
+{
+    public:
+        // writes row y of the source (width pixels) into row, called once per row from any thread
+        using RowSource = std::function<void(int y, uint8_t* row)>;
+
+        static constexpr uint64_t MaxBoxArea = uint64_t(1) << 24;
+
+        void Build(int width, int height, const RowSource& source, ThreadPool* pool = nullptr);
+        void Build(const ConstImageView& plane, ThreadPool* pool = nullptr);
+
+        int GetWidth() const { return _width; }
+        int GetHeight() const { return _height; }
+
+        // 0 <= x <= width, 0 <= y <= height
+        uint32_t At(int x, int y) const { return _sums[(size_t)y * (_width + 1) + x]; }
+
+        // sum over [x0, x1) x [y0, y1), wrap-around cancels out in the differences
+        uint32_t BoxSum(int x0, int y0, int x1, int y1) const
+        {
+            return At(x1, y1) - At(x0, y1) - At(x1, y0) + At(x0, y0);
+        }
+
+        // sum over a box with fractional corners, pixels partly inside count with the covered part of their area
+        double AreaSum(double x0, double y0, double x1, double y1) const;
+
+    private:
+        int _width = 0;
+        int _height = 0;
+        std::vector<uint32_t> _sums;
+};
+
+// Area-average downscale of one plane into channel `channel` of dst, whose size sets the output size.
+// Output pixel (x, y) is the mean of the source box [x * scaleX, (x + 1) * scaleX) x [y * scaleY, (y + 1) * scaleY)
+// rounded to nearest, fractional scales weight the pixels cut by the box edges. Every output pixel costs O(1).
+// The box may cover at most SummedAreaTable::MaxBoxArea pixels.
+void DownscaleArea(const SummedAreaTable& table, double scaleX, double scaleY, ImageBuffer& dst, int channel, ThreadPool* pool = nullptr);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ImageView.hpp"
+
+// 8-bit luma with BT.601 weights in 8.8 fixed point; the weights add up to 256 so gray pixels keep their value
+inline uint8_t Luma(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+// luma of row y of three channel views, width pixels
+void LumaRow(const ConstImageView& red, const ConstImageView& green, const ConstImageView& blue, int y, uint8_t* dst);
+
+using Histogram = std::array<uint64_t, 256>;
+
+// Otsu's threshold: the value t maximizing the between-class variance of {v <= t} and {v > t}.
+// Foreground is v > t, a histogram with a single value gives that value (everything background).
+int OtsuThreshold(const Histogram& histogram);
+
+enum class ThresholdMode { Fixed, Otsu, Adaptive };
+
+// "otsu", "adaptive" or a value 0..255 (Fixed)
+bool ParseThreshold(const std::string& text, ThresholdMode& mode, int& value);
+
+std::string DescribeThreshold(ThresholdMode mode, int value);
+
+// Threshold of every BlockSize x BlockSize block of the image, or one global threshold when no blocks are set.
+// Blocks without a threshold of their own (too flat for Otsu) take the global one.
+class ThresholdMap
+{
+    public:
+        static constexpr int BlockSize = 64;
+        // blocks whose luma spans fewer values than this keep the global threshold
+        static constexpr int MinContrast = 24;
+
+        void SetGlobal(int threshold) { _global = threshold; }
+        int GetGlobal() const { return _global; }
+
+        // width x height image, every block starts on the global threshold; 0 x 0 removes the blocks
+        void ResizeBlocks(int width, int height);
+        bool HasBlocks() const { return _blocksX > 0; }
+        int GetBlocksX() const { return _blocksX; }
+
+        // Otsu threshold of the block histogram, or the global threshold for a flat block
+        void SetBlock(int blockX, int blockY, const Histogram& histogram);
+
+        int At(int x, int y) const;
+
+        // bit i of words is luma[i] > threshold of pixel (x0 + i, y), count pixels
+        void Pack(const uint8_t* luma, int x0, int y, int count, uint64_t* words) const;
+
+    private:
+        int _global = 0;
+        int _blocksX = 0;
+        int _blocksY = 0;
+        // -1: global threshold
+        std::vector<int> _blocks;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <ThreadPool.hpp>
+
+// [X0, X1) x [Y0, Y1)
+struct TileRect {
+    int X0, Y0, X1, Y1;
+
+    bool IsEmpty() const { return X0 >= X1 || Y0 >= Y1; }
+};
+
+// Runs image processing phases tile by tile on a ThreadPool.
+// A tile of a phase starts as soon as every tile of the previous phase it reads
+// (its input region, halo included) is done, so phases overlap without a global barrier
+// and each output pixel is written exactly once: the result does not depend on the thread count.
+class TileScheduler
+{
+    public:
+        using TileFunction = std::function<void(const TileRect& tile)>;
+        // area of the previous phase output read by a tile of this phase
+        using RegionFunction = std::function<TileRect(const TileRect& tile)>;
+
+        TileScheduler(int tileWidth = 256, int tileHeight = 64);
+
+        // the first phase has no dependencies, every later one reads the output of the phase before it:
+        // a tile waits for the previous phase tiles overlapping inputRegion(tile), for all of them when it is null
+        void AddPhase(int width, int height, TileFunction process, RegionFunction inputRegion = nullptr);
+
+        // blocks until every tile of every phase is processed
+        void Run(ThreadPool& pool);
+
+        // same tiles in phase order on the calling thread
+        void RunSequential();
+
+    private:
+        struct Phase {
+            int Width, Height;
+            int TilesX, TilesY;
+            int FirstTask;
+            TileFunction Process;
+            RegionFunction InputRegion;
+        };
+
+        struct Task {
+            int PhaseId;
+            TileRect Rect;
+            std::atomic<int> Dependencies{0};
+            std::vector<int> Successors;
+        };
+
+        TileRect GetTileRect(const Phase& phase, int tileX, int tileY) const;
+        void BuildTasks(std::vector<Task>& tasks) const;
+        void RunTask(std::vector<Task>& tasks, int taskId, TaskGroup& group);
+
+    private:
+        int _tileWidth;
+        int _tileHeight;
+        std::vector<Phase> _phases;
+};
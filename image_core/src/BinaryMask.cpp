@@ -0,0 +1,72 @@
+#include "BinaryMask.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void BinaryMask::Resize(int width, int height)
+{
+    _width = width;
+    _height = height;
+    _wordsPerRow = WordCount(width);
+    _words.assign((size_t)_wordsPerRow * height, 0);
+}
+
+void BinaryMask::Invert()
+{
+    for (uint64_t& word : _words) word = ~word;
+    ClearPadding();
+}
+
+void BinaryMask::ClearPadding()
+{
+    int used = _width % WordBits;
+    if (used == 0) return;
+
+    uint64_t keep = (uint64_t(1) << used) - 1;
+    for (int y = 0; y < _height; y++) Row(y)[_wordsPerRow - 1] &= keep;
+}
+
+void PackThreshold(const uint8_t* values, int pixelStep, int count, int threshold, uint64_t* words)
+{
+    for (int wordX = 0; wordX < count; wordX += BinaryMask::WordBits)
+    {
+        int wordCount = std::min(BinaryMask::WordBits, count - wordX);
+        uint64_t word = 0;
+        for (int i = 0; i < wordCount; i++)
+        {
+            word |= (uint64_t)(values[(wordX + i) * pixelStep] > threshold) << i;
+        }
+        words[wordX / BinaryMask::WordBits] = word;
+    }
+}
+
+void ExpandMaskBits(const uint64_t* words, int count, uint8_t zero, uint8_t one, uint8_t* dst)
+{
+    // 8 output bytes per mask byte
+    static thread_local uint8_t cachedZero = 0, cachedOne = 0;
+    static thread_local bool cached = false;
+    static thread_local uint64_t table[256];
+    if (!cached || cachedZero != zero || cachedOne != one)
+    {
+        for (int bits = 0; bits < 256; bits++)
+        {
+            uint8_t bytes[8];
+            for (int i = 0; i < 8; i++) bytes[i] = (bits >> i) & 1 ? one : zero;
+            std::memcpy(&table[bits], bytes, 8);
+        }
+        cachedZero = zero;
+        cachedOne = one;
+        cached = true;
+    }
+
+    int x = 0;
+    for (; x + 8 <= count; x += 8)
+    {
+        uint8_t bits = (uint8_t)(words[x / BinaryMask::WordBits] >> (x % BinaryMask::WordBits));
+        std::memcpy(dst + x, &table[bits], 8);
+    }
+    for (; x < count; x++)
+    {
+        dst[x] = (words[x / BinaryMask::WordBits] >> (x % BinaryMask::WordBits)) & 1 ? one : zero;
+    }
+}
@@ -0,0 +1,214 @@
+#include "ConnectedComponents.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+
+#include <ConcurrentUnionFind.hpp>
+#include <ThreadPool.hpp>
+
+namespace
+{
+    // [X0, X1) of one row
+    struct Run {
+        int X0, X1;
+    };
+
+    // rows per strip labelled by one task
+    constexpr int StripRows = 64;
+
+    inline int CountTrailingZeros(uint64_t value)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(value);
+#else
+        int count = 0;
+        while (!(value & 1))
+        {
+            value >>= 1;
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    inline int PopCount(uint64_t value)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(value);
+#else
+        int count = 0;
+        for (; value; value &= value - 1) count++;
+        return count;
+#endif
+    }
+
+    int CountRuns(const uint64_t* row, int words)
+    {
+        int count = 0;
+        uint64_t previousTop = 0;
+        for (int word = 0; word < words; word++)
+        {
+            // a run starts on a set bit whose left neighbour is clear
+            uint64_t bits = row[word];
+            count += PopCount(bits & ~((bits << 1) | previousTop));
+            previousTop = bits >> (BinaryMask::WordBits - 1);
+        }
+        return count;
+    }
+
+    void ExtractRuns(const uint64_t* row, int words, Run* runs)
+    {
+        int x = 0;
+        const int end = words * BinaryMask::WordBits;
+        while (x < end)
+        {
+            int word = x / BinaryMask::WordBits;
+            uint64_t bits = row[word] & (~uint64_t(0) << (x % BinaryMask::WordBits));
+            while (!bits && ++word < words) bits = row[word];
+            if (!bits) return;
+
+            int start = word * BinaryMask::WordBits + CountTrailingZeros(bits);
+            bits = ~row[word] & (~uint64_t(0) << (start % BinaryMask::WordBits));
+            while (!bits && ++word < words) bits = ~row[word];
+
+            // padding bits are clear, so a run only reaches the end of the words at the last pixel
+            x = word < words ? word * BinaryMask::WordBits + CountTrailingZeros(bits) : end;
+            *runs++ = { start, x };
+        }
+    }
+
+    // Joins the runs of two consecutive rows that touch (8) or overlap (4).
+    // Inside a strip the lower row is only known to the calling thread: its first join is a plain attach.
+    void JoinRows(const Run* upper, uint32_t upperFirst, uint32_t upperCount,
+                  const Run* lower, uint32_t lowerFirst, uint32_t lowerCount, int reach, bool lowerIsPrivate, ConcurrentUnionFind& sets)
+    {
+        uint32_t i = 0, j = 0;
+        bool attached = false;
+        while (i < upperCount && j < lowerCount)
+        {
+            const Run& a = upper[i];
+            const Run& b = lower[j];
+            if (a.X0 < b.X1 + reach && b.X0 < a.X1 + reach)
+            {
+                if (lowerIsPrivate && !attached) sets.Attach(lowerFirst + j, upperFirst + i);
+                else sets.Union(upperFirst + i, lowerFirst + j);
+                attached = true;
+            }
+
+            if (a.X1 < b.X1) i++;
+            else
+            {
+                j++;
+                attached = false;
+            }
+        }
+    }
+}
+
+std::vector<ComponentStats> LabelComponents(const BinaryMask& mask, int connectivity, ThreadPool* pool)
+{
+    const int height = mask.GetHeight();
+    const int words = mask.GetWordsPerRow();
+    const int reach = connectivity == 4 ? 0 : 1;
+    const int strips = (height + StripRows - 1) / StripRows;
+
+    auto parallelFor = [&](size_t end, const std::function<void(size_t, size_t)>& fn) {
+        if (pool) pool->ParallelFor(0, end, fn, 1);
+        else fn(0, end);
+    };
+
+    // run ids follow the scan order: rowFirst[y] is the id of the first run of row y
+    std::vector<uint32_t> rowFirst(height + 1, 0);
+    parallelFor(height, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++) rowFirst[y + 1] = CountRuns(mask.Row((int)y), words);
+    });
+    for (int y = 0; y < height; y++) rowFirst[y + 1] += rowFirst[y];
+
+    const uint32_t runCount = rowFirst[height];
+    // filled by the strips, no need to clear it first
+    std::unique_ptr<Run[]> runs(new Run[runCount]);
+    ConcurrentUnionFind sets;
+    sets.Resize(runCount);
+
+    // strips never share a run inside them, the joins across strip borders follow once every strip is done
+    parallelFor(strips, [&](size_t begin, size_t end) {
+        for (size_t strip = begin; strip < end; strip++)
+        {
+            int firstY = (int)strip * StripRows;
+            int endY = std::min(firstY + StripRows, height);
+            sets.MakeSets(rowFirst[firstY], rowFirst[endY]);
+            for (int y = firstY; y < endY; y++)
+            {
+                ExtractRuns(mask.Row(y), words, runs.get() + rowFirst[y]);
+                if (y == firstY) continue;
+
+                JoinRows(runs.get() + rowFirst[y - 1], rowFirst[y - 1], rowFirst[y] - rowFirst[y - 1],
+                         runs.get() + rowFirst[y], rowFirst[y], rowFirst[y + 1] - rowFirst[y], reach, true, sets);
+            }
+        }
+    });
+
+    parallelFor(strips > 0 ? strips - 1 : 0, [&](size_t begin, size_t end) {
+        for (size_t border = begin; border < end; border++)
+        {
+            int y = (int)(border + 1) * StripRows;
+            JoinRows(runs.get() + rowFirst[y - 1], rowFirst[y - 1], rowFirst[y] - rowFirst[y - 1],
+                     runs.get() + rowFirst[y], rowFirst[y], rowFirst[y + 1] - rowFirst[y], reach, false, sets);
+        }
+    });
+
+    // The root of a component is its first run in scan order, so numbering the roots in order numbers the components.
+    // A parent always comes before its children, which therefore take its component without a Find.
+    std::unique_ptr<uint32_t[]> componentOf(new uint32_t[runCount]);
+    std::vector<ComponentStats> components;
+    for (int y = 0; y < height; y++)
+    {
+        for (uint32_t id = rowFirst[y]; id < rowFirst[y + 1]; id++)
+        {
+            const Run& run = runs[id];
+            uint32_t parent = sets.Parent(id);
+            if (parent == id)
+            {
+                componentOf[id] = (uint32_t)components.size();
+                components.push_back({ 0, run.X0, y, run.X1 - 1, y, 0, 0 });
+            }
+            else componentOf[id] = componentOf[parent];
+
+            ComponentStats& stats = components[componentOf[id]];
+            uint64_t length = run.X1 - run.X0;
+            stats.Area += length;
+            stats.MinX = std::min(stats.MinX, run.X0);
+            stats.MaxX = std::max(stats.MaxX, run.X1 - 1);
+            stats.MaxY = y;
+            stats.SumX += length * (uint64_t)(run.X0 + run.X1 - 1) / 2;
+            stats.SumY += length * (uint64_t)y;
+        }
+    }
+
+    return components;
+}
+
+bool WriteComponentsCsv(const std::string& filename, const std::vector<ComponentStats>& components)
+{
+    FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file)
+    {
+        std::cerr << "Couldn't write file: " << filename << "\n";
+        return false;
+    }
+
+    std::fprintf(file, "label,area,min_x,min_y,max_x,max_y,centroid_x,centroid_y\n");
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        const ComponentStats& stats = components[i];
+        std::fprintf(file, "%zu,%llu,%d,%d,%d,%d,%.3f,%.3f\n", i + 1, (unsigned long long)stats.Area,
+                     stats.MinX, stats.MinY, stats.MaxX, stats.MaxY, stats.CentroidX(), stats.CentroidY());
+    }
+
+    bool written = std::fclose(file) == 0;
+    if (!written) std::cerr << "Couldn't write file: " << filename << "\n";
+    return written;
+}
@@ -0,0 +1,44 @@
+#include "CpuFeatures.hpp"
+
+#include <cstdlib>
+#include <string>
+
+static SimdLevel DetectSimdLevel()
+{
+#if defined(IMAGE_CORE_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+    if (__builtin_cpu_supports("sse4.1")) return SimdLevel::Sse41;
+#endif
+    return SimdLevel::Scalar;
+}
+
+static SimdLevel ApplyOverride(SimdLevel detected)
+{
+    const char* value = std::getenv("IMAGE_CORE_SIMD");
+    if (!value) return detected;
+
+    std::string requested = value;
+    SimdLevel level = detected;
+    if (requested == "scalar") level = SimdLevel::Scalar;
+    else if (requested == "sse4") level = SimdLevel::Sse41;
+    else if (requested == "avx2") level = SimdLevel::Avx2;
+
+    return level < detected ? level : detected;
+}
+
+SimdLevel GetSimdLevel()
+{
+    static const SimdLevel level = ApplyOverride(DetectSimdLevel());
+    return level;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::Avx2: return "AVX2";
+        case SimdLevel::Sse41: return "SSE4.1";
+        default: return "scalar";
+    }
+}
@@ -0,0 +1,135 @@
+#include "ImageBatch.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include <Pipeline.hpp>
+
+namespace fs = std::filesystem;
+
+static bool IsImageExtension(std::string extension)
+{
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+    // formats stb_image decodes
+    static const char* extensions[] = { ".bmp", ".png", ".jpg", ".jpeg", ".tga", ".gif", ".psd", ".hdr", ".pic", ".pnm", ".ppm", ".pgm" };
+    for (const char* known : extensions)
+    {
+        if (extension == known) return true;
+    }
+    return false;
+}
+
+// every input is saved under its file name without extension, two inputs with the same one would overwrite each other
+static bool CheckOutputNames(const std::vector<std::string>& files)
+{
+    std::map<std::string, const std::string*> stems;
+    for (const std::string& file : files)
+    {
+        auto inserted = stems.emplace(fs::path(file).stem().string(), &file);
+        if (!inserted.second)
+        {
+            std::cout << "Inputs " << *inserted.first->second << " and " << file << " would be saved to the same output file\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CollectBatchInputs(const std::string& source, std::vector<std::string>& files)
+{
+    files.clear();
+    std::error_code error;
+
+    if (fs::is_directory(source, error))
+    {
+        for (const fs::directory_entry& entry : fs::directory_iterator(source, error))
+        {
+            if (entry.is_regular_file(error) && IsImageExtension(entry.path().extension().string()))
+            {
+                files.push_back(entry.path().string());
+            }
+        }
+        if (error)
+        {
+            std::cout << "Couldn't list directory: " << source << "\n";
+            return false;
+        }
+
+        std::sort(files.begin(), files.end());
+        return CheckOutputNames(files);
+    }
+
+    std::ifstream list(source);
+    if (!list)
+    {
+        std::cout << "Couldn't open batch list: " << source << "\n";
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(list, line))
+    {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        files.push_back(line);
+    }
+    return CheckOutputNames(files);
+}
+
+bool PrepareBatchOutput(const std::string& outputDirectory)
+{
+    std::error_code error;
+    if (fs::is_directory(outputDirectory, error)) return true;
+
+    if (!fs::create_directories(outputDirectory, error))
+    {
+        std::cerr << "Couldn't create directory: " << outputDirectory << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::string BatchOutputPath(const std::string& outputDirectory, const std::string& inputFile, const std::string& extension)
+{
+    fs::path name = fs::path(inputFile).filename();
+    name.replace_extension(extension);
+    return (fs::path(outputDirectory) / name).string();
+}
+
+bool RunImageBatch(const std::string& inputSource, const std::string& outputDirectory, const std::string& extension, int numThreads,
+                   const std::function<bool(const std::string& file, int slot)>& load,
+                   const std::function<void(int slot)>& process,
+                   const std::function<bool(const std::string& file, int slot)>& save)
+{
+    std::vector<std::string> inputs;
+    if (!CollectBatchInputs(inputSource, inputs) || !PrepareBatchOutput(outputDirectory)) return false;
+
+    std::cout << "Batch of " << inputs.size() << " image(s) with " << numThreads << " thread(s)" << std::endl;
+    auto tsBegin = std::chrono::steady_clock::now();
+
+    size_t saved = RunPipeline(inputs.size(), BatchSlotCount,
+        [&](size_t item, int slot) {
+            if (load(inputs[item], slot)) return true;
+            std::cout << " (" << inputs[item] << " skipped)" << std::endl;
+            return false;
+        },
+        [&](size_t, int slot) {
+            process(slot);
+            return true;
+        },
+        [&](size_t item, int slot) {
+            return save(BatchOutputPath(outputDirectory, inputs[item], extension), slot);
+        });
+
+    auto tsEnd = std::chrono::steady_clock::now();
+    std::cout << "Batch done: " << saved << " of " << inputs.size() << " image(s) saved to " << outputDirectory
+              << ". Time elapsed: " << std::chrono::duration_cast<std::chrono::milliseconds>(tsEnd - tsBegin).count() << " ms" << std::endl;
+
+    return saved == inputs.size();
+}
@@ -0,0 +1,64 @@
+#include "ImageBuffer.hpp"
+
+#include <ThreadPool.hpp>
+
+ImageBuffer::ImageBuffer(int width, int height, int channels)
+{
+    Resize(width, height, channels);
+}
+
+void ImageBuffer::Resize(int width, int height, int channels)
+{
+    _width = width;
+    _height = height;
+    _channels = channels;
+    _stride = (width + RowAlignment - 1) / RowAlignment * RowAlignment;
+    _planeSize = _stride * height;
+
+    size_t required = _planeSize * channels + RowAlignment;
+    if (_capacity < required)
+    {
+        // default-initialized: the pages are only touched by whoever writes the pixels first
+        _storage.reset(new uint8_t[required]);
+        _capacity = required;
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(_storage.get());
+    _planes = _storage.get() + (RowAlignment - address % RowAlignment) % RowAlignment;
+}
+
+void ImageBuffer::CopyFrom(const ConstImageView* channelViews, int channels, ThreadPool* pool)
+{
+    Resize(channelViews[0].Width, channelViews[0].Height, channels);
+
+    // all channels of a row are copied together, interleaved sources are read once
+    auto copyRows = [this, channelViews, channels](size_t startY, size_t endY)
+    {
+        for (int y = (int)startY; y < (int)endY; y++)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                const ConstImageView& view = channelViews[c];
+                const uint8_t* src = view.Row(y);
+                uint8_t* dst = Row(c, y);
+                for (int x = 0; x < _width; x++)
+                {
+                    dst[x] = src[x * view.PixelStep];
+                }
+            }
+        }
+    };
+
+    if (pool) pool->ParallelFor(0, _height, copyRows);
+    else copyRows(0, _height);
+}
+
+void ImageBuffer::FromInterleaved(const unsigned char* data, int width, int height, int channels)
+{
+    ConstImageView views[4];
+    for (int c = 0; c < channels && c < 4; c++)
+    {
+        views[c] = ConstImageView::Interleaved(data, width, height, channels, c);
+    }
+    CopyFrom(views, channels < 4 ? channels : 4);
+}
@@ -0,0 +1,566 @@
+#include "ImageIO.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <ThreadPool.hpp>
+
+#include "PngEncoder.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace
+{
+    constexpr size_t BmpFileHeaderSize = 14;
+    constexpr size_t BmpInfoHeaderSize = 40;
+
+    uint32_t ReadLittleEndian(const uint8_t* src, int bytes)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < bytes; i++) value |= (uint32_t)src[i] << (8 * i);
+        return value;
+    }
+
+    void PutLittleEndian(uint8_t* dst, uint32_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++) dst[i] = (uint8_t)(value >> (8 * i));
+    }
+
+    size_t BmpRowSize(int width, int bitsPerPixel)
+    {
+        return (((size_t)width * bitsPerPixel + 31) / 32) * 4;
+    }
+
+    struct BmpLayout {
+        int Width = 0;
+        int Height = 0;
+        int BitsPerPixel = 0;
+        bool TopDown = false;
+        size_t DataOffset = 0;
+        size_t RowSize = 0;
+    };
+
+    // Only uncompressed 24 and 32-bit files are read natively,
+    // palettes, bitfields and RLE are left to stb_image
+    bool ParseBmpHeader(const uint8_t* header, size_t headerBytes, uint64_t fileSize, BmpLayout& layout)
+    {
+        if (headerBytes < BmpFileHeaderSize + BmpInfoHeaderSize || header[0] != 'B' || header[1] != 'M') return false;
+
+        uint32_t dataOffset = ReadLittleEndian(header + 10, 4);
+        uint32_t infoSize = ReadLittleEndian(header + 14, 4);
+        int32_t width = (int32_t)ReadLittleEndian(header + 18, 4);
+        int32_t height = (int32_t)ReadLittleEndian(header + 22, 4);
+        uint32_t planes = ReadLittleEndian(header + 26, 2);
+        uint32_t bitsPerPixel = ReadLittleEndian(header + 28, 2);
+        uint32_t compression = ReadLittleEndian(header + 30, 4);
+
+        bool topDown = height < 0;
+        // rows are checked against the pixel data by division, rowSize * rows could wrap for a crafted header
+        int64_t rows = topDown ? -(int64_t)height : height;
+        size_t rowSize = BmpRowSize(width, bitsPerPixel);
+
+        bool supported = infoSize >= BmpInfoHeaderSize && planes == 1 && compression == 0 &&
+            (bitsPerPixel == 24 || bitsPerPixel == 32) && width > 0 && rows > 0 && rows <= INT32_MAX &&
+            dataOffset <= fileSize && (uint64_t)rows <= (fileSize - dataOffset) / rowSize;
+        if (!supported) return false;
+
+        layout.Width = width;
+        layout.Height = (int)rows;
+        layout.BitsPerPixel = (int)bitsPerPixel;
+        layout.TopDown = topDown;
+        layout.DataOffset = dataOffset;
+        layout.RowSize = rowSize;
+        return true;
+    }
+
+    // the palette (4 bytes per color) goes right after the header, the caller fills it
+    void WriteBmpHeader(uint8_t* header, int width, int height, int bitsPerPixel = 24, int paletteColors = 0)
+    {
+        size_t dataSize = BmpRowSize(width, bitsPerPixel) * height;
+        size_t dataOffset = BmpFileHeaderSize + BmpInfoHeaderSize + 4 * (size_t)paletteColors;
+
+        std::memset(header, 0, BmpFileHeaderSize + BmpInfoHeaderSize);
+        header[0] = 'B';
+        header[1] = 'M';
+        PutLittleEndian(header + 2, (uint32_t)(dataOffset + dataSize), 4);
+        PutLittleEndian(header + 10, (uint32_t)dataOffset, 4);
+        PutLittleEndian(header + 14, BmpInfoHeaderSize, 4);
+        PutLittleEndian(header + 18, width, 4);
+        PutLittleEndian(header + 22, height, 4);
+        PutLittleEndian(header + 26, 1, 2);
+        PutLittleEndian(header + 28, bitsPerPixel, 2);
+        PutLittleEndian(header + 34, (uint32_t)dataSize, 4);
+        PutLittleEndian(header + 46, paletteColors, 4);
+    }
+
+    // mask bytes hold their first pixel in bit 0, BMP and PBM bytes in bit 7
+    uint8_t ReverseBits(uint8_t value)
+    {
+        static const auto table = [] {
+            std::vector<uint8_t> values(256);
+            for (int n = 0; n < 256; n++)
+            {
+                for (int i = 0; i < 8; i++) values[n] |= ((n >> i) & 1) << (7 - i);
+            }
+            return values;
+        }();
+        return table[value];
+    }
+
+    // row y of the image goes to dstTop + y * dstStride as BGR, a single plane is written as gray
+    void EncodeBmpRows(const ImageBuffer& image, uint8_t* dstTop, ptrdiff_t dstStride, size_t rowSize, ThreadPool* pool)
+    {
+        const int width = image.GetWidth();
+        const int last = image.GetChannels() - 1;
+        const int r = 0, g = last < 1 ? last : 1, b = last < 2 ? last : 2;
+        auto encodeRows = [&](size_t startY, size_t endY)
+        {
+            for (int y = (int)startY; y < (int)endY; y++)
+            {
+                const uint8_t* red = image.Row(r, y);
+                const uint8_t* green = image.Row(g, y);
+                const uint8_t* blue = image.Row(b, y);
+                uint8_t* row = dstTop + y * dstStride;
+                for (int x = 0; x < width; x++)
+                {
+                    row[x * 3] = blue[x];
+                    row[x * 3 + 1] = green[x];
+                    row[x * 3 + 2] = red[x];
+                }
+                std::memset(row + (size_t)width * 3, 0, rowSize - (size_t)width * 3);
+            }
+        };
+
+        if (pool) pool->ParallelFor(0, image.GetHeight(), encodeRows);
+        else encodeRows(0, image.GetHeight());
+    }
+
+    bool SeekFile(std::FILE* file, uint64_t offset)
+    {
+#if defined(_WIN32)
+        return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+        return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+    }
+}
+
+void DecodedImage::DecoderFree::operator()(unsigned char* data) const
+{
+    stbi_image_free(data);
+}
+
+bool DecodedImage::Load(const std::string& filename, int channels)
+{
+    Release();
+
+    if (channels == 3 && MapBmp(filename, channels)) return true;
+
+    _data.reset(stbi_load(filename.c_str(), &_width, &_height, &_sourceChannels, channels));
+
+    if (!_data)
+    {
+        std::cout << "Failed to load image";
+        return false;
+    }
+
+    _channels = channels;
+    _pixels = _data.get();
+    _rowStride = (ptrdiff_t)_width * channels;
+    _pixelStep = channels;
+    _bgr = false;
+    return true;
+}
+
+bool DecodedImage::MapBmp(const std::string& filename, int channels)
+{
+    if (!_file.OpenRead(filename)) return false;
+
+    BmpLayout layout;
+    if (!ParseBmpHeader(_file.Data(), _file.Size(), _file.Size(), layout))
+    {
+        _file.Close();
+        return false;
+    }
+
+    _file.AdviseSequential();
+
+    const uint8_t* pixels = _file.Data() + layout.DataOffset;
+    _width = layout.Width;
+    _height = layout.Height;
+    _channels = channels;
+    _sourceChannels = layout.BitsPerPixel / 8;
+    _pixelStep = layout.BitsPerPixel / 8;
+    _bgr = true;
+    _pixels = layout.TopDown ? pixels : pixels + (size_t)(layout.Height - 1) * layout.RowSize;
+    _rowStride = layout.TopDown ? (ptrdiff_t)layout.RowSize : -(ptrdiff_t)layout.RowSize;
+    return true;
+}
+
+void DecodedImage::Release()
+{
+    _data.reset();
+    _file.Close();
+    _pixels = nullptr;
+    _width = _height = _channels = _sourceChannels = 0;
+}
+
+bool LoadImage(const std::string& filename, ImageBuffer& image, int channels, int* sourceChannels, ThreadPool* pool)
+{
+    DecodedImage decoded;
+    if (!decoded.Load(filename, channels)) return false;
+
+    ConstImageView views[4];
+    for (int c = 0; c < channels; c++) views[c] = decoded.Channel(c);
+    image.CopyFrom(views, channels, pool);
+
+    if (sourceChannels) *sourceChannels = decoded.GetSourceChannels();
+    return true;
+}
+
+bool SaveBmp(const std::string& filename, const ImageBuffer& image, ThreadPool* pool)
+{
+    int width = image.GetWidth();
+    int height = image.GetHeight();
+    size_t rowSize = BmpRowSize(width, 24);
+
+    MappedFile file;
+    if (!file.Create(filename, BmpFileHeaderSize + BmpInfoHeaderSize + rowSize * height))
+    {
+        std::cerr << "Couldn't write file: " << filename << "\n";
+        return false;
+    }
+
+    // BMP rows go bottom-up
+    uint8_t* header = file.MutableData();
+    WriteBmpHeader(header, width, height);
+    uint8_t* pixels = header + BmpFileHeaderSize + BmpInfoHeaderSize;
+    EncodeBmpRows(image, pixels + (ptrdiff_t)(height - 1) * rowSize, -(ptrdiff_t)rowSize, rowSize, pool);
+    return true;
+}
+
+bool BmpBandReader::Open(const std::string& filename)
+{
+    Close();
+
+    _file = std::fopen(filename.c_str(), "rb");
+    uint8_t header[BmpFileHeaderSize + BmpInfoHeaderSize];
+    size_t headerBytes = _file ? std::fread(header, 1, sizeof(header), _file) : 0;
+
+    uint64_t fileSize = 0;
+    if (_file && std::fseek(_file, 0, SEEK_END) == 0)
+    {
+#if defined(_WIN32)
+        fileSize = (uint64_t)_ftelli64(_file);
+#else
+        fileSize = (uint64_t)ftello(_file);
+#endif
+    }
+
+    BmpLayout layout;
+    if (!_file || !ParseBmpHeader(header, headerBytes, fileSize, layout))
+    {
+        std::cout << "Couldn't stream image: " << filename << " (uncompressed 24/32-bit BMP expected)\n";
+        Close();
+        return false;
+    }
+
+    _width = layout.Width;
+    _height = layout.Height;
+    _bitsPerPixel = layout.BitsPerPixel;
+    _topDown = layout.TopDown;
+    _dataOffset = layout.DataOffset;
+    _rowSize = layout.RowSize;
+    return true;
+}
+
+void BmpBandReader::Close()
+{
+    if (_file) std::fclose(_file);
+    _file = nullptr;
+    _raw.clear();
+    _raw.shrink_to_fit();
+}
+
+bool BmpBandReader::ReadRows(int firstRow, int rowCount, ImageBuffer& band, int channels, ThreadPool* pool)
+{
+    if (!_file || firstRow < 0 || rowCount <= 0 || firstRow + rowCount > _height) return false;
+
+    // the band is one contiguous run of file rows, in reverse order for bottom-up files
+    int firstFileRow = _topDown ? firstRow : _height - firstRow - rowCount;
+    _raw.resize(_rowSize * rowCount);
+    if (!SeekFile(_file, _dataOffset + (uint64_t)firstFileRow * _rowSize) ||
+        std::fread(_raw.data(), 1, _raw.size(), _file) != _raw.size())
+    {
+        return false;
+    }
+
+    const uint8_t* top = _topDown ? _raw.data() : _raw.data() + (size_t)(rowCount - 1) * _rowSize;
+    ptrdiff_t stride = _topDown ? (ptrdiff_t)_rowSize : -(ptrdiff_t)_rowSize;
+    ConstImageView views[3];
+    for (int c = 0; c < channels && c < 3; c++)
+    {
+        views[c] = { top + 2 - c, _width, rowCount, stride, _bitsPerPixel / 8 };
+    }
+    band.CopyFrom(views, channels < 3 ? channels : 3, pool);
+    return true;
+}
+
+bool BmpBandWriter::Open(const std::string& filename, int width, int height)
+{
+    Close();
+
+    _file = std::fopen(filename.c_str(), "wb");
+    if (!_file)
+    {
+        std::cerr << "Couldn't write file: " << filename << "\n";
+        return false;
+    }
+
+    _width = width;
+    _height = height;
+    _rowSize = BmpRowSize(width, 24);
+    _failed = false;
+
+    uint8_t header[BmpFileHeaderSize + BmpInfoHeaderSize];
+    WriteBmpHeader(header, width, height);
+    if (std::fwrite(header, 1, sizeof(header), _file) != sizeof(header)) _failed = true;
+    return true;
+}
+
+bool BmpBandWriter::Close()
+{
+    bool written = !_failed;
+    if (_file && std::fclose(_file) != 0) written = false;
+    _file = nullptr;
+    _raw.clear();
+    _raw.shrink_to_fit();
+    return written;
+}
+
+bool BmpBandWriter::WriteRows(int firstRow, const ImageBuffer& band, ThreadPool* pool)
+{
+    int rowCount = band.GetHeight();
+    if (!_file || band.GetWidth() != _width || firstRow < 0 || firstRow + rowCount > _height)
+    {
+        // the file misses these rows, Close must not report it complete
+        _failed = true;
+        return false;
+    }
+    if (rowCount == 0) return true;
+
+    // BMP rows go bottom-up, the band lands in one contiguous run of file rows
+    _raw.resize(_rowSize * rowCount);
+    EncodeBmpRows(band, _raw.data() + (size_t)(rowCount - 1) * _rowSize, -(ptrdiff_t)_rowSize, _rowSize, pool);
+
+    uint64_t offset = BmpFileHeaderSize + BmpInfoHeaderSize + (uint64_t)(_height - firstRow - rowCount) * _rowSize;
+    if (!SeekFile(_file, offset) || std::fwrite(_raw.data(), 1, _raw.size(), _file) != _raw.size())
+    {
+        _failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool ParseMaskFormat(const std::string& name, MaskFormat& format)
+{
+    if (name == "bmp") format = MaskFormat::Bmp24;
+    else if (name == "bmp1") format = MaskFormat::Bmp1;
+    else if (name == "pbm") format = MaskFormat::Pbm;
+    else if (name == "png") format = MaskFormat::Png;
+    else
+    {
+        std::cout << "Unknown output format: " << name << " (expected bmp, bmp1, pbm or png)\n";
+        return false;
+    }
+    return true;
+}
+
+MaskFormat MaskFormatFromFilename(const std::string& filename)
+{
+    size_t dot = filename.find_last_of('.');
+    std::string extension = dot == std::string::npos ? std::string() : filename.substr(dot);
+    for (char& c : extension) c = (char)std::tolower((unsigned char)c);
+
+    if (extension == ".pbm") return MaskFormat::Pbm;
+    if (extension == ".png") return MaskFormat::Png;
+    return MaskFormat::Bmp24;
+}
+
+const char* MaskFormatExtension(MaskFormat format)
+{
+    switch (format)
+    {
+        case MaskFormat::Pbm: return ".pbm";
+        case MaskFormat::Png: return ".png";
+        default: return ".bmp";
+    }
+}
+
+MaskWriter::MaskWriter() = default;
+
+MaskWriter::~MaskWriter()
+{
+    Close();
+}
+
+bool MaskWriter::Open(const std::string& filename, int width, int height, MaskFormat format, uint8_t zero, uint8_t one)
+{
+    Close();
+
+    _file = std::fopen(filename.c_str(), "wb");
+    if (!_file)
+    {
+        std::cerr << "Couldn't write file: " << filename << "\n";
+        return false;
+    }
+
+    _failed = false;
+    _format = format;
+    _zero = zero;
+    _one = one;
+    _width = width;
+    _height = height;
+    _nextRow = 0;
+
+    if (format == MaskFormat::Png)
+    {
+        _rowSize = width;
+        if (!_png) _png = std::make_unique<PngEncoder>();
+        if (!_png->Begin(_file, width, height)) _failed = true;
+        return true;
+    }
+
+    if (format == MaskFormat::Pbm)
+    {
+        _rowSize = ((size_t)width + 7) / 8;
+        std::string header = "P4\n" + std::to_string(width) + " " + std::to_string(height) + "\n";
+        if (std::fwrite(header.data(), 1, header.size(), _file) != header.size()) _failed = true;
+        return true;
+    }
+
+    // BMP: the two levels are the palette of a 1-bit file
+    const int bitsPerPixel = format == MaskFormat::Bmp1 ? 1 : 24;
+    const int paletteColors = format == MaskFormat::Bmp1 ? 2 : 0;
+    uint8_t header[BmpFileHeaderSize + BmpInfoHeaderSize + 8] = {};
+    WriteBmpHeader(header, width, height, bitsPerPixel, paletteColors);
+    uint8_t* palette = header + BmpFileHeaderSize + BmpInfoHeaderSize;
+    for (int i = 0; i < 3 && paletteColors; i++)
+    {
+        palette[i] = zero;
+        palette[4 + i] = one;
+    }
+
+    _rowSize = BmpRowSize(width, bitsPerPixel);
+    _dataOffset = BmpFileHeaderSize + BmpInfoHeaderSize + 4 * (size_t)paletteColors;
+    if (std::fwrite(header, 1, _dataOffset, _file) != _dataOffset) _failed = true;
+    return true;
+}
+
+bool MaskWriter::Close()
+{
+    if (!_file) return false;
+
+    bool written = !_failed && _nextRow == _height;
+    if (_format == MaskFormat::Png && !_png->Finish()) written = false;
+    if (std::fclose(_file) != 0) written = false;
+    _file = nullptr;
+    _raw.clear();
+    _raw.shrink_to_fit();
+    return written;
+}
+
+void MaskWriter::EncodeRow(const uint64_t* words, uint8_t* dst) const
+{
+    if (_format == MaskFormat::Bmp24)
+    {
+        for (int x = 0; x < _width; x++)
+        {
+            uint8_t value = (words[x / BinaryMask::WordBits] >> (x % BinaryMask::WordBits)) & 1 ? _one : _zero;
+            dst[x * 3] = dst[x * 3 + 1] = dst[x * 3 + 2] = value;
+        }
+        std::memset(dst + (size_t)_width * 3, 0, _rowSize - (size_t)_width * 3);
+        return;
+    }
+
+    // 1 bit per pixel, first pixel in the high bit: palette index 1 for a set bit in the BMP,
+    // black (1) for the darker level in the PBM
+    const uint8_t flip = _format == MaskFormat::Pbm && _one > _zero ? 0xFF : 0x00;
+    const size_t usedBytes = ((size_t)_width + 7) / 8;
+    for (size_t i = 0; i < usedBytes; i++)
+    {
+        uint8_t bits = (uint8_t)(words[i / 8] >> (8 * (i % 8)));
+        dst[i] = ReverseBits(bits) ^ flip;
+    }
+    if (_width % 8) dst[usedBytes - 1] &= (uint8_t)(0xFF00 >> (_width % 8));
+    std::memset(dst + usedBytes, 0, _rowSize - usedBytes);
+}
+
+bool MaskWriter::WriteRows(const BinaryMask& mask, int firstMaskRow, int rowCount, ThreadPool* pool)
+{
+    if (!_file || mask.GetWidth() != _width || firstMaskRow < 0 || firstMaskRow + rowCount > mask.GetHeight() ||
+        _nextRow + rowCount > _height)
+    {
+        return false;
+    }
+    if (rowCount == 0) return true;
+
+    const int firstRow = _nextRow;
+    _nextRow += rowCount;
+
+    if (_format == MaskFormat::Png)
+    {
+        // the deflate stream runs through every row in order, one row is expanded at a time
+        _raw.resize(_rowSize);
+        for (int y = 0; y < rowCount; y++)
+        {
+            ExpandMaskBits(mask.Row(firstMaskRow + y), _width, _zero, _one, _raw.data());
+            if (!_png->WriteRow(_raw.data())) _failed = true;
+        }
+        return !_failed;
+    }
+
+    // BMP rows go bottom-up, the band lands in one contiguous run of file rows
+    const bool bottomUp = _format != MaskFormat::Pbm;
+    _raw.resize(_rowSize * rowCount);
+    auto encodeRows = [&](size_t startY, size_t endY)
+    {
+        for (size_t y = startY; y < endY; y++)
+        {
+            size_t fileRow = bottomUp ? rowCount - 1 - y : y;
+            EncodeRow(mask.Row(firstMaskRow + (int)y), _raw.data() + fileRow * _rowSize);
+        }
+    };
+    if (pool) pool->ParallelFor(0, rowCount, encodeRows);
+    else encodeRows(0, rowCount);
+
+    bool placed = !bottomUp || SeekFile(_file, _dataOffset + (uint64_t)(_height - firstRow - rowCount) * _rowSize);
+    if (!placed || std::fwrite(_raw.data(), 1, _raw.size(), _file) != _raw.size())
+    {
+        _failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool SaveMask(const std::string& filename, const BinaryMask& mask, MaskFormat format, uint8_t zero, uint8_t one, ThreadPool* pool)
+{
+    // bands bound the encoded rows held at once
+    const int bandRows = 256;
+
+    MaskWriter writer;
+    if (!writer.Open(filename, mask.GetWidth(), mask.GetHeight(), format, zero, one)) return false;
+
+    for (int firstRow = 0; firstRow < mask.GetHeight(); firstRow += bandRows)
+    {
+        if (!writer.WriteRows(mask, firstRow, std::min(bandRows, mask.GetHeight() - firstRow), pool)) break;
+    }
+
+    if (writer.Close()) return true;
+    std::cerr << "Couldn't write file: " << filename << "\n";
+    return false;
+}
@@ -0,0 +1,28 @@
+#include "ImageKernelsImpl.hpp"
+
+#include <cstdlib>
+
+static ImageKernels SelectKernels(SimdLevel level)
+{
+#if defined(IMAGE_CORE_X86_SIMD)
+    if (level == SimdLevel::Avx2) return { level, &ConvolveRowAvx2, &Downscale2xRowAvx2 };
+    if (level == SimdLevel::Sse41) return { level, &ConvolveRowSse41, &Downscale2xRowSse41 };
+#endif
+    return { SimdLevel::Scalar, &ConvolveRowScalar, &Downscale2xRowScalar };
+}
+
+const ImageKernels& GetImageKernels()
+{
+    static const ImageKernels kernels = SelectKernels(GetSimdLevel());
+    return kernels;
+}
+
+bool FitsInt16Accumulator(const ConvolutionTaps& taps)
+{
+    long long reach = 0;
+    for (int i = 0; i < taps.Width * taps.Height; i++)
+    {
+        reach += std::abs(taps.Weights[i]) * 255LL;
+    }
+    return reach <= INT16_MAX;
+}
@@ -0,0 +1,89 @@
+// Compiled with -mavx2, only reached after GetSimdLevel() reported AVX2 support
+#include "ImageKernelsImpl.hpp"
+
+#if defined(IMAGE_CORE_X86_SIMD)
+
+#include <immintrin.h>
+
+// truncating division of 16 int16 lanes, exact for |value| < 2^15
+static inline __m256i DivideInt16(__m256i value, __m256 divisor)
+{
+    __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(value)));
+    __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(value, 1)));
+    __m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(_mm256_div_ps(lo, divisor)),
+                                        _mm256_cvttps_epi32(_mm256_div_ps(hi, divisor)));
+    // packs works per 128-bit lane, restore the element order
+    return _mm256_permute4x64_epi64(packed, 0xD8);
+}
+
+static inline __m256i PackUnsigned(__m256i lo, __m256i hi)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+}
+
+void ConvolveRowAvx2(const ConvolutionTaps& taps, const uint8_t* src, size_t srcStride, int y,
+                     uint8_t* dstRow, int startX, int endX)
+{
+    const uint8_t* topLeft = src + (y - taps.Height / 2) * srcStride - taps.Width / 2;
+    const bool normalize = taps.WeightSum != 1;
+    const __m256 divisor = _mm256_set1_ps((float)taps.WeightSum);
+
+    int x = startX;
+    for (; x + 32 <= endX; x += 32)
+    {
+        __m256i accLo = _mm256_setzero_si256();
+        __m256i accHi = _mm256_setzero_si256();
+
+        for (int convY = 0; convY < taps.Height; convY++)
+        {
+            const uint8_t* srcRow = topLeft + convY * srcStride + x;
+            const int* weightRow = taps.Weights + convY * taps.Width;
+            for (int convX = 0; convX < taps.Width; convX++)
+            {
+                if (weightRow[convX] == 0) continue;
+
+                __m256i weight = _mm256_set1_epi16((short)weightRow[convX]);
+                __m256i px = _mm256_loadu_si256((const __m256i*)(srcRow + convX));
+                __m256i pxLo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(px));
+                __m256i pxHi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(px, 1));
+                accLo = _mm256_add_epi16(accLo, _mm256_mullo_epi16(pxLo, weight));
+                accHi = _mm256_add_epi16(accHi, _mm256_mullo_epi16(pxHi, weight));
+            }
+        }
+
+        if (normalize)
+        {
+            accLo = DivideInt16(accLo, divisor);
+            accHi = DivideInt16(accHi, divisor);
+        }
+
+        _mm256_storeu_si256((__m256i*)(dstRow + x), PackUnsigned(accLo, accHi));
+    }
+
+    if (x < endX) ConvolveRowSse41(taps, src, srcStride, y, dstRow, x, endX);
+}
+
+void Downscale2xRowAvx2(const uint8_t* rowA, const uint8_t* rowB, uint8_t* dst, int count)
+{
+    const __m256i ones = _mm256_set1_epi8(1);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)(rowA + 2 * i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(rowA + 2 * i + 32));
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(rowB + 2 * i));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(rowB + 2 * i + 32));
+
+        __m256i sumLo = _mm256_add_epi16(_mm256_maddubs_epi16(a0, ones), _mm256_maddubs_epi16(b0, ones));
+        __m256i sumHi = _mm256_add_epi16(_mm256_maddubs_epi16(a1, ones), _mm256_maddubs_epi16(b1, ones));
+
+        sumLo = _mm256_srli_epi16(sumLo, 2);
+        sumHi = _mm256_srli_epi16(sumHi, 2);
+        _mm256_storeu_si256((__m256i*)(dst + i), PackUnsigned(sumLo, sumHi));
+    }
+
+    if (i < count) Downscale2xRowSse41(rowA + 2 * i, rowB + 2 * i, dst + i, count - i);
+}
+
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ImageKernels.hpp"
+
+// Per instruction set implementations, only called through GetImageKernels()
+
+void ConvolveRowScalar(const ConvolutionTaps& taps, const uint8_t* src, size_t srcStride, int y,
+                       uint8_t* dstRow, int startX, int endX);
+void Downscale2xRowScalar(const uint8_t* rowA, const uint8_t* rowB, uint8_t* dst, int count);
+
+#if defined(IMAGE_CORE_X86_SIMD)
+void ConvolveRowSse41(const ConvolutionTaps& taps, const uint8_t* src, size_t srcStride, int y,
+                      uint8_t* dstRow, int startX, int endX);
+void Downscale2xRowSse41(const uint8_t* rowA, const uint8_t* rowB, uint8_t* dst, int count);
+
+void ConvolveRowAvx2(const ConvolutionTaps& taps, const uint8_t* src, size_t srcStride, int y,
+                     uint8_t* dstRow, int startX, int endX);
+void Downscale2xRowAvx2(const uint8_t* rowA, const uint8_t* rowB, uint8_t* dst, int count);
+#endif
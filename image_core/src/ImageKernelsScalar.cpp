@@ -0,0 +1,33 @@
+#include "ImageKernelsImpl.hpp"
+
+void ConvolveRowScalar(const ConvolutionTaps& taps, const uint8_t* src, size_t srcStride, int y,
+                       uint8_t* dstRow, int startX, int endX)
+{
+    const uint8_t* topLeft = src + (y - taps.Height / 2) * srcStride - taps.Width / 2;
+    for (int x = startX; x < endX; x++)
+    {
+        int sum = 0;
+        for (int convY = 0; convY < taps.Height; convY++)
+        {
+            const uint8_t* srcRow = topLeft + convY * srcStride + x;
+            const int* weightRow = taps.Weights + convY * taps.Width;
+            for (int convX = 0; convX < taps.Width; convX++)
+            {
+                sum += srcRow[convX] * weightRow[convX];
+            }
+        }
+
+        sum /= taps.WeightSum;
+        if (sum < 0) sum = 0;
+        if (sum > 255) sum = 255;
+        dstRow[x] = (uint8_t)sum;
+    }
+}
+
+void Downscale2xRowScalar(const uint8_t* rowA, const uint8_t* rowB, uint8_t* dst, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        dst[i] = (uint8_t)((rowA[2 * i] + rowA[2 * i + 1] + rowB[2 * i] + rowB[2 * i + 1]) / 4);
+    }
+}
@@ -0,0 +1,81 @@
+// Compiled with -msse4.1, only reached after GetSimdLevel() reported SSE4.1 support
+#include "ImageKernelsImpl.hpp"
+
+#if defined(IMAGE_CORE_X86_SIMD)
+
+#include <smmintrin.h>
+
+// truncating division of 8 int16 lanes, exact for |value| < 2^15
+static inline __m128i DivideInt16(__m128i value, __m128 divisor)
+{
+    __m128 lo = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(value));
+    __m128 hi = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(value, 8)));
+    return _mm_packs_epi32(_mm_cvttps_epi32(_mm_div_ps(lo, divisor)), _mm_cvttps_epi32(_mm_div_ps(hi, divisor)));
+}
+
+void ConvolveRowSse41(const ConvolutionTaps& taps, const uint8_t* src, size_t srcStride, int y,
+                      uint8_t* dstRow, int startX, int endX)
+{
+    const uint8_t* topLeft = src + (y - taps.Height / 2) * srcStride - taps.Width / 2;
+    const bool normalize = taps.WeightSum != 1;
+    const __m128 divisor = _mm_set1_ps((float)taps.WeightSum);
+
+    int x = startX;
+    for (; x + 16 <= endX; x += 16)
+    {
+        __m128i accLo = _mm_setzero_si128();
+        __m128i accHi = _mm_setzero_si128();
+
+        for (int convY = 0; convY < taps.Height; convY++)
+        {
+            const uint8_t* srcRow = topLeft + convY * srcStride + x;
+            const int* weightRow = taps.Weights + convY * taps.Width;
+            for (int convX = 0; convX < taps.Width; convX++)
+            {
+                if (weightRow[convX] == 0) continue;
+
+                __m128i weight = _mm_set1_epi16((short)weightRow[convX]);
+                __m128i px = _mm_loadu_si128((const __m128i*)(srcRow + convX));
+                accLo = _mm_add_epi16(accLo, _mm_mullo_epi16(_mm_cvtepu8_epi16(px), weight));
+                accHi = _mm_add_epi16(accHi, _mm_mullo_epi16(_mm_cvtepu8_epi16(_mm_srli_si128(px, 8)), weight));
+            }
+        }
+
+        if (normalize)
+        {
+            accLo = DivideInt16(accLo, divisor);
+            accHi = DivideInt16(accHi, divisor);
+        }
+
+        // saturating pack is the clamp to [0, 255]
+        _mm_storeu_si128((__m128i*)(dstRow + x), _mm_packus_epi16(accLo, accHi));
+    }
+
+    if (x < endX) ConvolveRowScalar(taps, src, srcStride, y, dstRow, x, endX);
+}
+
+void Downscale2xRowSse41(const uint8_t* rowA, const uint8_t* rowB, uint8_t* dst, int count)
+{
+    const __m128i ones = _mm_set1_epi8(1);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(rowA + 2 * i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(rowA + 2 * i + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(rowB + 2 * i));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(rowB + 2 * i + 16));
+
+        // horizontal pair sums, then the vertical pair
+        __m128i sumLo = _mm_add_epi16(_mm_maddubs_epi16(a0, ones), _mm_maddubs_epi16(b0, ones));
+        __m128i sumHi = _mm_add_epi16(_mm_maddubs_epi16(a1, ones), _mm_maddubs_epi16(b1, ones));
+
+        sumLo = _mm_srli_epi16(sumLo, 2);
+        sumHi = _mm_srli_epi16(sumHi, 2);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(sumLo, sumHi));
+    }
+
+    if (i < count) Downscale2xRowScalar(rowA + 2 * i, rowB + 2 * i, dst + i, count - i);
+}
+
+#endif
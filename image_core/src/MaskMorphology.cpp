@@ -0,0 +1,289 @@
+#include "MaskMorphology.hpp"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+// below this window length shifting every word is cheaper than the block prefix/suffix passes
+static constexpr int ShiftWindowLimit = 16;
+
+static MorphologyMethod Resolve(MorphologyMethod method, int length)
+{
+    if (method != MorphologyMethod::Auto) return method;
+    return length <= ShiftWindowLimit ? MorphologyMethod::Shift : MorphologyMethod::VanHerk;
+}
+
+const char* MorphologyMethodName(MorphologyMethod method)
+{
+    switch (method)
+    {
+        case MorphologyMethod::Shift: return "shift";
+        case MorphologyMethod::VanHerk: return "vhgw";
+        default: return "auto";
+    }
+}
+
+static inline uint64_t LowBits(int count)
+{
+    return count >= BinaryMask::WordBits ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+}
+
+// every bit at or below the highest set bit
+static inline uint64_t SmearDown(uint64_t value)
+{
+    value |= value >> 1;
+    value |= value >> 2;
+    value |= value >> 4;
+    value |= value >> 8;
+    value |= value >> 16;
+    value |= value >> 32;
+    return value;
+}
+
+static void DilateRowShift(const uint64_t* row, int wordsPerRow, int x0, int wordCount, int before, int after, uint64_t* dst)
+{
+    for (int word = 0; word < wordCount; word++)
+    {
+        uint64_t bits = 0;
+        for (int offset = -before; offset <= after; offset++)
+        {
+            bits |= ShiftedWord(row, wordsPerRow, 0, x0 + word * BinaryMask::WordBits + offset);
+        }
+        dst[word] = bits;
+    }
+}
+
+// Blocks of `length` bits start at bit 0. prefix[p] ORs the bits from the start of p's block up to p,
+// suffix[p] from p up to the end of its block; a window of `length` bits starting at s is suffix[s] | prefix[s + length - 1].
+// Both scans cut every word at the block boundaries inside it and smear each piece with one subtraction,
+// the carry crosses word boundaries until the next block starts.
+static void BlockPrefixOr(const uint64_t* src, int words, int length, uint64_t* prefix)
+{
+    bool carry = false;
+    for (int word = 0; word < words; word++)
+    {
+        uint64_t bits = src[word], out = 0;
+        for (int lo = 0; lo < BinaryMask::WordBits; )
+        {
+            int position = (int)(((long long)word * BinaryMask::WordBits + lo) % length);
+            if (position == 0) carry = false;
+
+            int count = std::min(BinaryMask::WordBits - lo, length - position);
+            uint64_t mask = LowBits(count);
+            uint64_t piece = (bits >> lo) & mask;
+            uint64_t smeared = carry ? mask : (piece | (0 - piece)) & mask;
+
+            out |= smeared << lo;
+            carry = (smeared >> (count - 1)) & 1;
+            lo += count;
+        }
+        prefix[word] = out;
+    }
+}
+
+static void BlockSuffixOr(const uint64_t* src, int words, int length, uint64_t* suffix)
+{
+    bool carry = false;
+    for (int word = words - 1; word >= 0; word--)
+    {
+        uint64_t bits = src[word], out = 0;
+        for (int hi = BinaryMask::WordBits; hi > 0; )
+        {
+            long long end = (long long)word * BinaryMask::WordBits + hi;
+            if (end % length == 0) carry = false;
+
+            int count = std::min(hi, (int)((end - 1) % length) + 1);
+            int lo = hi - count;
+            uint64_t mask = LowBits(count);
+            uint64_t piece = (bits >> lo) & mask;
+            uint64_t smeared = carry ? mask : SmearDown(piece);
+
+            out |= smeared << lo;
+            carry = smeared & 1;
+            hi = lo;
+        }
+        suffix[word] = out;
+    }
+}
+
+static void DilateRowVanHerk(const uint64_t* row, int wordsPerRow, int x0, int wordCount, int before, int after, uint64_t* dst)
+{
+    const int length = before + after + 1;
+    // local bit p is row pixel x0 - before + p
+    const int localWords = BinaryMask::WordCount(wordCount * BinaryMask::WordBits + length - 1);
+
+    static thread_local std::vector<uint64_t> source, prefix, suffix;
+    source.resize(localWords);
+    prefix.resize(localWords);
+    suffix.resize(localWords);
+
+    for (int word = 0; word < localWords; word++)
+    {
+        source[word] = ShiftedWord(row, wordsPerRow, 0, x0 - before + word * BinaryMask::WordBits);
+    }
+
+    BlockPrefixOr(source.data(), localWords, length, prefix.data());
+    BlockSuffixOr(source.data(), localWords, length, suffix.data());
+
+    for (int word = 0; word < wordCount; word++)
+    {
+        dst[word] = suffix[word] | ShiftedWord(prefix.data(), localWords, word, length - 1);
+    }
+}
+
+void DilateRowSpan(const uint64_t* row, int wordsPerRow, int x0, int wordCount, int before, int after,
+                   uint64_t* dst, MorphologyMethod method)
+{
+    if (before + after < 0)
+    {
+        std::fill(dst, dst + wordCount, 0);
+        return;
+    }
+
+    if (Resolve(method, before + after + 1) == MorphologyMethod::Shift) DilateRowShift(row, wordsPerRow, x0, wordCount, before, after, dst);
+    else DilateRowVanHerk(row, wordsPerRow, x0, wordCount, before, after, dst);
+}
+
+void DilateColumnSpan(const uint64_t* src, size_t srcStride, int rowCount, int wordCount, int before, int after,
+                      int firstOut, int outCount, uint64_t* dst, size_t dstStride, MorphologyMethod method)
+{
+    const int length = before + after + 1;
+    auto sourceRow = [&](int r) { return r >= 0 && r < rowCount ? src + (size_t)r * srcStride : nullptr; };
+
+    if (length <= 0 || Resolve(method, length) == MorphologyMethod::Shift)
+    {
+        for (int out = 0; out < outCount; out++)
+        {
+            uint64_t* dstRow = dst + (size_t)out * dstStride;
+            std::fill(dstRow, dstRow + wordCount, 0);
+
+            int r = firstOut + out;
+            for (int windowRow = std::max(r - before, 0); windowRow <= std::min(r + after, rowCount - 1); windowRow++)
+            {
+                const uint64_t* row = sourceRow(windowRow);
+                for (int word = 0; word < wordCount; word++) dstRow[word] |= row[word];
+            }
+        }
+        return;
+    }
+
+    // local row q is source row firstOut - before + q, blocks of `length` rows start at q = 0
+    const int localRows = outCount + length - 1;
+    static thread_local std::vector<uint64_t> prefix, suffix;
+    prefix.resize((size_t)localRows * wordCount);
+    suffix.resize((size_t)localRows * wordCount);
+
+    for (int q = 0; q < localRows; q++)
+    {
+        const uint64_t* row = sourceRow(firstOut - before + q);
+        uint64_t* current = prefix.data() + (size_t)q * wordCount;
+        const uint64_t* previous = current - wordCount;
+        bool blockStart = q % length == 0;
+        for (int word = 0; word < wordCount; word++)
+        {
+            uint64_t bits = row ? row[word] : 0;
+            current[word] = blockStart ? bits : bits | previous[word];
+        }
+    }
+
+    for (int q = localRows - 1; q >= 0; q--)
+    {
+        const uint64_t* row = sourceRow(firstOut - before + q);
+        uint64_t* current = suffix.data() + (size_t)q * wordCount;
+        const uint64_t* next = current + wordCount;
+        bool blockEnd = q == localRows - 1 || (q + 1) % length == 0;
+        for (int word = 0; word < wordCount; word++)
+        {
+            uint64_t bits = row ? row[word] : 0;
+            current[word] = blockEnd ? bits : bits | next[word];
+        }
+    }
+
+    for (int out = 0; out < outCount; out++)
+    {
+        const uint64_t* suffixRow = suffix.data() + (size_t)out * wordCount;
+        const uint64_t* prefixRow = prefix.data() + (size_t)(out + length - 1) * wordCount;
+        uint64_t* dstRow = dst + (size_t)out * dstStride;
+        for (int word = 0; word < wordCount; word++) dstRow[word] = suffixRow[word] | prefixRow[word];
+    }
+}
+
+void WindowOr(const BinaryMask& src, int offsetX, int offsetY, const StructuringElement& element, BinaryMask& dst,
+              MorphologyMethod method)
+{
+    const int wordCount = dst.GetWordsPerRow();
+    const int rowCount = dst.GetHeight();
+    const size_t dstWords = (size_t)wordCount * rowCount;
+
+    // runs [left, right] of set cells (relative to the origin) -> element rows (dy) holding them
+    std::map<std::pair<int, int>, std::vector<int>> runs;
+    for (int y = 0; y < element.Height; y++)
+    {
+        for (int x = 0; x < element.Width; x++)
+        {
+            if (!element.At(x, y) || (x > 0 && element.At(x - 1, y))) continue;
+
+            int end = x;
+            while (end + 1 < element.Width && element.At(end + 1, y)) end++;
+            runs[{ x - element.OriginX, end - element.OriginX }].push_back(y - element.OriginY);
+        }
+    }
+
+    for (int y = 0; y < rowCount; y++) std::fill(dst.Row(y), dst.Row(y) + wordCount, 0);
+
+    static thread_local std::vector<uint64_t> rows, columns;
+    for (auto& run : runs)
+    {
+        const int left = run.first.first, right = run.first.second;
+        const std::vector<int>& dys = run.second;
+
+        // src rows any dy of the run reaches, clipped to src
+        const int rowBegin = std::max(offsetY + dys.front(), 0);
+        const int rowEnd = std::min(offsetY + rowCount + dys.back(), src.GetHeight());
+        if (rowBegin >= rowEnd) continue;
+
+        rows.resize((size_t)(rowEnd - rowBegin) * wordCount);
+        for (int y = rowBegin; y < rowEnd; y++)
+        {
+            DilateRowSpan(src.Row(y), src.GetWordsPerRow(), offsetX, wordCount, -left, right,
+                          rows.data() + (size_t)(y - rowBegin) * wordCount, method);
+        }
+
+        // every contiguous range of dy is one column dilation
+        columns.resize(dstWords);
+        for (size_t first = 0; first < dys.size(); )
+        {
+            size_t last = first;
+            while (last + 1 < dys.size() && dys[last + 1] == dys[last] + 1) last++;
+
+            DilateColumnSpan(rows.data(), wordCount, rowEnd - rowBegin, wordCount, -dys[first], dys[last],
+                             offsetY - rowBegin, rowCount, columns.data(), wordCount, method);
+            for (int y = 0; y < rowCount; y++)
+            {
+                uint64_t* dstRow = dst.Row(y);
+                const uint64_t* column = columns.data() + (size_t)y * wordCount;
+                for (int word = 0; word < wordCount; word++) dstRow[word] |= column[word];
+            }
+            first = last + 1;
+        }
+    }
+
+    dst.ClearPadding();
+}
+
+void ErodeMask(BinaryMask& src, int offsetX, int offsetY, const StructuringElement& element, BinaryMask& dst,
+               MorphologyMethod method)
+{
+    // a pixel survives when no background pixel lies under the element
+    src.Invert();
+    WindowOr(src, offsetX, offsetY, element, dst, method);
+    dst.Invert();
+    src.Invert();
+}
+
+void DilateMask(const BinaryMask& src, int offsetX, int offsetY, const StructuringElement& element, BinaryMask& dst,
+                MorphologyMethod method)
+{
+    WindowOr(src, offsetX, offsetY, element.Reflected(), dst, method);
+}
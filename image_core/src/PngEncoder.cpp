@@ -0,0 +1,231 @@
+#include "PngEncoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr size_t ChunkCapacity = 64 * 1024;
+    constexpr uint32_t AdlerModulo = 65521;
+    // bytes that can be summed before the adler32 sums can overflow 32 bits
+    constexpr size_t AdlerBlock = 5552;
+
+    // deflate length codes 257..285: first length of every code and its extra bits
+    constexpr int LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                     35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr int LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+    void PutBigEndian(uint8_t* dst, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++) dst[i] = (uint8_t)(value >> (24 - 8 * i));
+    }
+
+    uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        static const auto table = [] {
+            std::vector<uint32_t> values(256);
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                values[n] = c;
+            }
+            return values;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // length of the run of data[0] starting at data, at most `count`
+    size_t RunLength(const uint8_t* data, size_t count)
+    {
+        uint64_t pattern = 0x0101010101010101ull * data[0];
+        size_t length = 1;
+        while (length + 8 <= count)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + length, 8);
+            if (word != pattern) break;
+            length += 8;
+        }
+        while (length < count && data[length] == data[0]) length++;
+        return length;
+    }
+}
+
+bool PngEncoder::Begin(std::FILE* file, int width, int height)
+{
+    _file = file;
+    _failed = false;
+    _width = width;
+    _previous.assign(width, 0);
+    _filtered.resize((size_t)width + 1);
+    _adlerA = 1;
+    _adlerB = 0;
+    _last = -1;
+    _run = 0;
+    _bitBuffer = 0;
+    _bitCount = 0;
+    _chunk.clear();
+    _chunk.reserve(ChunkCapacity + 16);
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (std::fwrite(signature, 1, sizeof(signature), _file) != sizeof(signature)) _failed = true;
+
+    // 8-bit gray, deflate, adaptive filtering, no interlace
+    uint8_t header[13] = {};
+    PutBigEndian(header, (uint32_t)width);
+    PutBigEndian(header + 4, (uint32_t)height);
+    header[8] = 8;
+    WriteChunk("IHDR", header, sizeof(header));
+
+    // zlib header (deflate, 32K window, no dictionary) and the block header: last block, fixed Huffman codes
+    _chunk.push_back(0x78);
+    _chunk.push_back(0x01);
+    PutBits(1, 1);
+    PutBits(1, 2);
+    return !_failed;
+}
+
+bool PngEncoder::WriteRow(const uint8_t* row)
+{
+    // Up filter: difference with the pixel above, the first row is compared to zeros
+    _filtered[0] = 2;
+    for (int x = 0; x < _width; x++) _filtered[x + 1] = (uint8_t)(row[x] - _previous[x]);
+    std::memcpy(_previous.data(), row, _width);
+
+    Deflate(_filtered.data(), _filtered.size());
+    return !_failed;
+}
+
+bool PngEncoder::Finish()
+{
+    FlushRun();
+    PutHuffman(0, 7);   // end of block
+    if (_bitCount > 0) PutBits(0, 8 - _bitCount);
+
+    uint8_t adler[4];
+    PutBigEndian(adler, (_adlerB << 16) | _adlerA);
+    _chunk.insert(_chunk.end(), adler, adler + 4);
+    FlushChunk();
+    WriteChunk("IEND", nullptr, 0);
+
+    _previous.clear();
+    _previous.shrink_to_fit();
+    _filtered.clear();
+    _filtered.shrink_to_fit();
+    return !_failed;
+}
+
+void PngEncoder::Deflate(const uint8_t* data, size_t count)
+{
+    for (size_t begin = 0; begin < count; begin += AdlerBlock)
+    {
+        size_t end = std::min(begin + AdlerBlock, count);
+        for (size_t i = begin; i < end; i++)
+        {
+            _adlerA += data[i];
+            _adlerB += _adlerA;
+        }
+        _adlerA %= AdlerModulo;
+        _adlerB %= AdlerModulo;
+    }
+
+    for (size_t i = 0; i < count; )
+    {
+        size_t length = RunLength(data + i, count - i);
+        if (data[i] == _last) _run += length;
+        else
+        {
+            FlushRun();
+            PutLiteral(data[i]);
+            _last = data[i];
+            _run = length - 1;
+        }
+        i += length;
+    }
+}
+
+// repeats of the last byte: matches at distance 1, the 1 or 2 bytes too short for a match as literals
+void PngEncoder::FlushRun()
+{
+    while (_run >= 3)
+    {
+        size_t length = std::min<size_t>(_run, 258);
+        // a remainder of 1 or 2 is cheaper folded into the previous match than as literals
+        if (_run - length > 0 && _run - length < 3) length = _run - 3;
+        PutMatch((int)length);
+        _run -= length;
+    }
+    for (; _run > 0; _run--) PutLiteral(_last);
+}
+
+void PngEncoder::PutLiteral(int value)
+{
+    if (value < 144) PutHuffman(0x30 + value, 8);
+    else PutHuffman(0x190 + value - 144, 9);
+}
+
+void PngEncoder::PutMatch(int length)
+{
+    int code = 28;
+    if (length < 258)
+    {
+        code = 0;
+        while (LengthBase[code + 1] <= length) code++;
+    }
+
+    int symbol = 257 + code;
+    if (symbol < 280) PutHuffman(symbol - 256, 7);
+    else PutHuffman(0xC0 + symbol - 280, 8);
+    PutBits((uint32_t)(length - LengthBase[code]), LengthExtra[code]);
+    PutHuffman(0, 5);   // distance 1
+}
+
+void PngEncoder::PutBits(uint32_t bits, int count)
+{
+    _bitBuffer |= (uint64_t)bits << _bitCount;
+    _bitCount += count;
+    while (_bitCount >= 8)
+    {
+        _chunk.push_back((uint8_t)_bitBuffer);
+        _bitBuffer >>= 8;
+        _bitCount -= 8;
+    }
+    if (_chunk.size() >= ChunkCapacity) FlushChunk();
+}
+
+// Huffman codes are stored starting from their most significant bit
+void PngEncoder::PutHuffman(uint32_t code, int length)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++) reversed |= ((code >> i) & 1) << (length - 1 - i);
+    PutBits(reversed, length);
+}
+
+void PngEncoder::FlushChunk()
+{
+    if (_chunk.empty()) return;
+    WriteChunk("IDAT", _chunk.data(), _chunk.size());
+    _chunk.clear();
+}
+
+bool PngEncoder::WriteChunk(const char* type, const uint8_t* data, size_t size)
+{
+    uint8_t head[8];
+    PutBigEndian(head, (uint32_t)size);
+    std::memcpy(head + 4, type, 4);
+
+    uint8_t crc[4];
+    PutBigEndian(crc, Crc32(Crc32(0, head + 4, 4), data, size));
+
+    if (std::fwrite(head, 1, 8, _file) != 8 || (size && std::fwrite(data, 1, size, _file) != size) ||
+        std::fwrite(crc, 1, 4, _file) != 4)
+    {
+        _failed = true;
+    }
+    return !_failed;
+}
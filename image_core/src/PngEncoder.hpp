@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// 8-bit grayscale PNG written one row at a time, only the previous row and one IDAT chunk are held.
+// Rows use the Up filter and are deflated in a single fixed Huffman block whose only matches are
+// byte runs (distance 1): two-level images compress to a few bits per row where nothing changes.
+class PngEncoder
+{
+    public:
+        // writes the signature and IHDR to file, which stays owned by the caller
+        bool Begin(std::FILE* file, int width, int height);
+        // the next image row, `width` gray bytes
+        bool WriteRow(const uint8_t* row);
+        // ends the zlib stream and writes the last IDAT and IEND, false when any write failed
+        bool Finish();
+
+    private:
+        void Deflate(const uint8_t* data, size_t count);
+        void FlushRun();
+        void PutLiteral(int value);
+        void PutMatch(int length);
+        void PutBits(uint32_t bits, int count);
+        void PutHuffman(uint32_t code, int length);
+        void FlushChunk();
+        bool WriteChunk(const char* type, const uint8_t* data, size_t size);
+
+    private:
+        std::FILE* _file = nullptr;
+        bool _failed = false;
+        int _width = 0;
+        std::vector<uint8_t> _previous;
+        std::vector<uint8_t> _filtered;
+
+        // adler32 of the uncompressed stream
+        uint32_t _adlerA = 1;
+        uint32_t _adlerB = 0;
+
+        // last byte passed to the compressor (-1 before the first) and how many repeats of it are pending
+        int _last = -1;
+        size_t _run = 0;
+
+        uint64_t _bitBuffer = 0;
+        int _bitCount = 0;
+        std::vector<uint8_t> _chunk;
+};
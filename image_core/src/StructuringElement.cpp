@@ -0,0 +1,161 @@
+#include "StructuringElement.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+// larger elements are accepted but the tile halo grows with them
+static constexpr int MaxElementSize = 1024;
+
+bool StructuringElement::IsEmpty() const
+{
+    for (uint8_t cell : Cells)
+    {
+        if (cell) return false;
+    }
+    return true;
+}
+
+StructuringElement StructuringElement::Reflected() const
+{
+    StructuringElement reflected = *this;
+    reflected.OriginX = Width - 1 - OriginX;
+    reflected.OriginY = Height - 1 - OriginY;
+    for (int y = 0; y < Height; y++)
+    {
+        for (int x = 0; x < Width; x++) reflected.Cells[y * Width + x] = Cells[(Height - 1 - y) * Width + (Width - 1 - x)];
+    }
+    return reflected;
+}
+
+static StructuringElement MakeElement(const std::string& name, int size)
+{
+    StructuringElement element;
+    element.Name = name + std::to_string(size);
+    element.Width = size;
+    element.Height = size;
+    element.OriginX = (size - 1) / 2;
+    element.OriginY = (size - 1) / 2;
+    element.Cells.assign((size_t)size * size, 0);
+    return element;
+}
+
+StructuringElement MakeSquareElement(int size)
+{
+    StructuringElement element = MakeElement("square", size);
+    std::fill(element.Cells.begin(), element.Cells.end(), 1);
+    return element;
+}
+
+StructuringElement MakeCrossElement(int size)
+{
+    StructuringElement element = MakeElement("cross", size);
+    for (int i = 0; i < size; i++)
+    {
+        element.Cells[element.OriginY * size + i] = 1;
+        element.Cells[i * size + element.OriginX] = 1;
+    }
+    return element;
+}
+
+StructuringElement MakeDiscElement(int size)
+{
+    StructuringElement element = MakeElement("disc", size);
+    // cell centers within size / 2 of the element center, in half cell units;
+    // the - 2 drops the corners of the 3x3 disc so it is a cross like the smallest digital disc
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            int dx = 2 * x - (size - 1);
+            int dy = 2 * y - (size - 1);
+            element.Cells[y * size + x] = dx * dx + dy * dy <= size * size - 2;
+        }
+    }
+    return element;
+}
+
+bool LoadStructuringElement(const std::string& filename, StructuringElement& element)
+{
+    std::ifstream input{filename};
+
+    if (!input.is_open())
+    {
+        std::cerr << "Couldn't read structuring element file: " << filename << "\n";
+        return false;
+    }
+
+    StructuringElement loaded;
+    loaded.Name = filename;
+
+    for (std::string line; std::getline(input, line);)
+    {
+        line = line.substr(0, line.find('#'));
+
+        std::vector<uint8_t> row;
+        for (char c : line)
+        {
+            if (c == '0' || c == '1') row.push_back(c == '1');
+            else if (!std::isspace((unsigned char)c) && c != ',' && c != ';')
+            {
+                std::cerr << "Structuring element file " << filename << ": bad cell '" << c << "'\n";
+                return false;
+            }
+        }
+
+        if (row.empty()) continue;
+
+        if (loaded.Width != 0 && (int)row.size() != loaded.Width)
+        {
+            std::cerr << "Structuring element file " << filename << ": all rows must have " << loaded.Width << " cells\n";
+            return false;
+        }
+
+        loaded.Width = row.size();
+        loaded.Height++;
+        loaded.Cells.insert(loaded.Cells.end(), row.begin(), row.end());
+    }
+
+    if (loaded.Cells.empty() || loaded.IsEmpty())
+    {
+        std::cerr << "Structuring element file " << filename << " has no cells set\n";
+        return false;
+    }
+
+    if (loaded.Width > MaxElementSize || loaded.Height > MaxElementSize)
+    {
+        std::cerr << "Structuring element file " << filename << " is larger than " << MaxElementSize << " cells\n";
+        return false;
+    }
+
+    loaded.OriginX = (loaded.Width - 1) / 2;
+    loaded.OriginY = (loaded.Height - 1) / 2;
+    element = loaded;
+    return true;
+}
+
+bool ResolveStructuringElement(const std::string& spec, StructuringElement& element)
+{
+    size_t digits = spec.find_first_of("0123456789");
+    std::string shape = spec.substr(0, digits);
+
+    if (digits != std::string::npos && spec.find_first_not_of("0123456789", digits) == std::string::npos &&
+        (shape.empty() || shape == "square" || shape == "cross" || shape == "disc"))
+    {
+        int size = std::atoi(spec.c_str() + digits);
+        if (size < 1 || size > MaxElementSize)
+        {
+            std::cerr << "Structuring element size must be 1.." << MaxElementSize << ": " << spec << "\n";
+            return false;
+        }
+
+        if (shape == "cross") element = MakeCrossElement(size);
+        else if (shape == "disc") element = MakeDiscElement(size);
+        else element = MakeSquareElement(size);
+        return true;
+    }
+
+    return LoadStructuringElement(spec, element);
+}
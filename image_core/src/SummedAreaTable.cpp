@@ -0,0 +1,153 @@
+#include "SummedAreaTable.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <ThreadPool.hpp>
+
+// running sums of a column band go down the whole table, wide enough bands keep the rows streaming
+static constexpr size_t ColumnBandWidth = 512;
+
+void SummedAreaTable::Build(int width, int height, const RowSource& source, ThreadPool* pool)
+{
+    _width = width;
+    _height = height;
+    size_t stride = (size_t)width + 1;
+    _sums.assign(stride * ((size_t)height + 1), 0);
+
+    // pass 1: prefix sums along every row, row y of the source goes to table row y + 1
+    auto prefixRows = [&](size_t startY, size_t endY)
+    {
+        std::vector<uint8_t> row(width);
+        for (size_t y = startY; y < endY; y++)
+        {
+            source((int)y, row.data());
+            uint32_t* sums = _sums.data() + (y + 1) * stride;
+            uint32_t running = 0;
+            for (int x = 0; x < width; x++)
+            {
+                running += row[x];
+                sums[x + 1] = running;
+            }
+        }
+    };
+
+    // pass 2: every row adds the row above it, bands of columns are independent
+    auto accumulateColumns = [&](size_t startX, size_t endX)
+    {
+        for (size_t y = 1; y <= (size_t)height; y++)
+        {
+            const uint32_t* above = _sums.data() + (y - 1) * stride;
+            uint32_t* sums = _sums.data() + y * stride;
+            for (size_t x = startX; x < endX; x++) sums[x] += above[x];
+        }
+    };
+
+    if (pool)
+    {
+        pool->ParallelFor(0, height, prefixRows);
+        pool->ParallelFor(1, stride, accumulateColumns, ColumnBandWidth);
+    }
+    else
+    {
+        prefixRows(0, height);
+        accumulateColumns(1, stride);
+    }
+}
+
+void SummedAreaTable::Build(const ConstImageView& plane, ThreadPool* pool)
+{
+    Build(plane.Width, plane.Height, [&plane](int y, uint8_t* row) {
+        const uint8_t* src = plane.Row(y);
+        for (int x = 0; x < plane.Width; x++) row[x] = src[x * plane.PixelStep];
+    }, pool);
+}
+
+// [start, end) cut into the partly covered first pixel, the fully covered pixels and the partly covered last pixel,
+// segment i is [bounds[i], bounds[i + 1]) with every pixel weighted by weights[i]
+static void SplitSpan(double start, double end, int size, int bounds[4], double weights[3])
+{
+    int first = (int)start;
+    int last = std::min((int)end, size);
+
+    // inside a single pixel
+    if (first == last)
+    {
+        bounds[0] = first;
+        bounds[1] = bounds[2] = bounds[3] = first + 1;
+        weights[0] = end - start;
+        weights[1] = weights[2] = 0.0;
+        return;
+    }
+
+    bounds[0] = first;
+    bounds[1] = first + 1;
+    bounds[2] = last;
+    bounds[3] = last < size ? last + 1 : last;
+    weights[0] = 1.0 - (start - first);
+    weights[1] = 1.0;
+    weights[2] = end - last;
+}
+
+double SummedAreaTable::AreaSum(double x0, double y0, double x1, double y1) const
+{
+    int xBounds[4], yBounds[4];
+    double xWeights[3], yWeights[3];
+    SplitSpan(x0, x1, _width, xBounds, xWeights);
+    SplitSpan(y0, y1, _height, yBounds, yWeights);
+
+    // every part is an exact integer box sum, only the weights are fractional
+    double sum = 0.0;
+    for (int j = 0; j < 3; j++)
+    {
+        if (yBounds[j] >= yBounds[j + 1] || yWeights[j] <= 0.0) continue;
+        for (int i = 0; i < 3; i++)
+        {
+            if (xBounds[i] >= xBounds[i + 1] || xWeights[i] <= 0.0) continue;
+            sum += xWeights[i] * yWeights[j] * BoxSum(xBounds[i], yBounds[j], xBounds[i + 1], yBounds[j + 1]);
+        }
+    }
+    return sum;
+}
+
+void DownscaleArea(const SummedAreaTable& table, double scaleX, double scaleY, ImageBuffer& dst, int channel, ThreadPool* pool)
+{
+    const int width = dst.GetWidth();
+    const int height = dst.GetHeight();
+    const bool integral = scaleX == std::floor(scaleX) && scaleY == std::floor(scaleY);
+
+    auto downscaleRows = [&](size_t startY, size_t endY)
+    {
+        for (int y = (int)startY; y < (int)endY; y++)
+        {
+            uint8_t* dstRow = dst.Row(channel, y);
+
+            if (integral)
+            {
+                // exact integer sums, rounded to nearest
+                const int boxWidth = (int)scaleX, boxHeight = (int)scaleY;
+                const uint64_t area = (uint64_t)boxWidth * boxHeight;
+                const int y0 = y * boxHeight;
+                for (int x = 0; x < width; x++)
+                {
+                    uint64_t sum = table.BoxSum(x * boxWidth, y0, (x + 1) * boxWidth, y0 + boxHeight);
+                    dstRow[x] = (uint8_t)((sum + area / 2) / area);
+                }
+                continue;
+            }
+
+            const double area = scaleX * scaleY;
+            const double y0 = y * scaleY;
+            const double y1 = std::min((y + 1) * scaleY, (double)table.GetHeight());
+            for (int x = 0; x < width; x++)
+            {
+                double x1 = std::min((x + 1) * scaleX, (double)table.GetWidth());
+                double mean = table.AreaSum(x * scaleX, y0, x1, y1) / area;
+                dstRow[x] = (uint8_t)std::min(std::max(mean + 0.5, 0.0), 255.0);
+            }
+        }
+    };
+
+    if (pool) pool->ParallelFor(0, height, downscaleRows);
+    else downscaleRows(0, height);
+}
@@ -0,0 +1,150 @@
+#include "Threshold.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "BinaryMask.hpp"
+
+// constant steps let the compiler vectorize the interleaved (3, 4) and planar (1) layouts
+template <int Step>
+static void LumaRowStep(const uint8_t* r, const uint8_t* g, const uint8_t* b, int width, uint8_t* dst)
+{
+    for (int x = 0; x < width; x++) dst[x] = Luma(r[x * Step], g[x * Step], b[x * Step]);
+}
+
+void LumaRow(const ConstImageView& red, const ConstImageView& green, const ConstImageView& blue, int y, uint8_t* dst)
+{
+    const uint8_t* r = red.Row(y);
+    const uint8_t* g = green.Row(y);
+    const uint8_t* b = blue.Row(y);
+    const int step = red.PixelStep;
+
+    if (green.PixelStep == step && blue.PixelStep == step)
+    {
+        switch (step)
+        {
+            case 1: LumaRowStep<1>(r, g, b, red.Width, dst); return;
+            case 3: LumaRowStep<3>(r, g, b, red.Width, dst); return;
+            case 4: LumaRowStep<4>(r, g, b, red.Width, dst); return;
+        }
+    }
+
+    for (int x = 0; x < red.Width; x++)
+    {
+        dst[x] = Luma(r[x * red.PixelStep], g[x * green.PixelStep], b[x * blue.PixelStep]);
+    }
+}
+
+int OtsuThreshold(const Histogram& histogram)
+{
+    double total = 0, sum = 0;
+    int lowest = -1;
+    for (int value = 0; value < 256; value++)
+    {
+        total += histogram[value];
+        sum += (double)value * histogram[value];
+        if (lowest < 0 && histogram[value]) lowest = value;
+    }
+
+    // the first maximum wins so the result is stable
+    double background = 0, backgroundSum = 0, best = -1;
+    int threshold = std::max(lowest, 0);
+    for (int value = 0; value < 255; value++)
+    {
+        background += histogram[value];
+        backgroundSum += (double)value * histogram[value];
+
+        double foreground = total - background;
+        if (background == 0 || foreground == 0) continue;
+
+        double difference = backgroundSum / background - (sum - backgroundSum) / foreground;
+        double variance = background * foreground * difference * difference;
+        if (variance > best)
+        {
+            best = variance;
+            threshold = value;
+        }
+    }
+    return threshold;
+}
+
+bool ParseThreshold(const std::string& text, ThresholdMode& mode, int& value)
+{
+    if (text == "otsu") mode = ThresholdMode::Otsu;
+    else if (text == "adaptive") mode = ThresholdMode::Adaptive;
+    else
+    {
+        size_t parsed = 0;
+        int parsedValue = -1;
+        try { parsedValue = std::stoi(text, &parsed); } catch (const std::exception&) {}
+        if (text.empty() || parsed != text.size() || parsedValue < 0 || parsedValue > 255)
+        {
+            std::cout << "Bad threshold (expected 0..255, otsu or adaptive): " << text << "\n";
+            return false;
+        }
+        mode = ThresholdMode::Fixed;
+        value = parsedValue;
+    }
+    return true;
+}
+
+std::string DescribeThreshold(ThresholdMode mode, int value)
+{
+    switch (mode)
+    {
+        case ThresholdMode::Otsu: return "otsu";
+        case ThresholdMode::Adaptive: return "adaptive";
+        default: return std::to_string(value);
+    }
+}
+
+void ThresholdMap::ResizeBlocks(int width, int height)
+{
+    _blocksX = (width + BlockSize - 1) / BlockSize;
+    _blocksY = (height + BlockSize - 1) / BlockSize;
+    _blocks.assign((size_t)_blocksX * _blocksY, -1);
+}
+
+void ThresholdMap::SetBlock(int blockX, int blockY, const Histogram& histogram)
+{
+    int lowest = 0, highest = 255;
+    while (lowest < 255 && !histogram[lowest]) lowest++;
+    while (highest > 0 && !histogram[highest]) highest--;
+
+    _blocks[(size_t)blockY * _blocksX + blockX] = highest - lowest < MinContrast ? -1 : OtsuThreshold(histogram);
+}
+
+int ThresholdMap::At(int x, int y) const
+{
+    if (!HasBlocks()) return _global;
+
+    int threshold = _blocks[(size_t)(y / BlockSize) * _blocksX + x / BlockSize];
+    return threshold < 0 ? _global : threshold;
+}
+
+void ThresholdMap::Pack(const uint8_t* luma, int x0, int y, int count, uint64_t* words) const
+{
+    if (!HasBlocks())
+    {
+        PackThreshold(luma, 1, count, _global, words);
+        return;
+    }
+
+    // blocks are at least a word wide, so the pixels of a word fall into at most two of them
+    static_assert(BlockSize >= BinaryMask::WordBits, "a mask word must not span more than two blocks");
+    for (int wordX = 0; wordX < count; wordX += BinaryMask::WordBits)
+    {
+        int wordCount = std::min(BinaryMask::WordBits, count - wordX);
+        int x = x0 + wordX;
+        int split = BlockSize - x % BlockSize;
+        int first = At(x, y);
+        int second = split < wordCount ? At(x + split, y) : first;
+
+        uint64_t word = 0;
+        for (int i = 0; i < wordCount; i++)
+        {
+            word |= (uint64_t)(luma[wordX + i] > (i < split ? first : second)) << i;
+        }
+        words[wordX / BinaryMask::WordBits] = word;
+    }
+}
@@ -0,0 +1,123 @@
+#include "TileScheduler.hpp"
+
+#include <algorithm>
+
+TileScheduler::TileScheduler(int tileWidth, int tileHeight) :
+    _tileWidth(std::max(tileWidth, 1)),
+    _tileHeight(std::max(tileHeight, 1))
+{
+}
+
+void TileScheduler::AddPhase(int width, int height, TileFunction process, RegionFunction inputRegion)
+{
+    Phase phase;
+    phase.Width = std::max(width, 0);
+    phase.Height = std::max(height, 0);
+    phase.TilesX = (phase.Width + _tileWidth - 1) / _tileWidth;
+    phase.TilesY = (phase.Height + _tileHeight - 1) / _tileHeight;
+    phase.FirstTask = _phases.empty() ? 0 : _phases.back().FirstTask + _phases.back().TilesX * _phases.back().TilesY;
+    phase.Process = std::move(process);
+    phase.InputRegion = std::move(inputRegion);
+
+    _phases.push_back(std::move(phase));
+}
+
+TileRect TileScheduler::GetTileRect(const Phase& phase, int tileX, int tileY) const
+{
+    return {
+        tileX * _tileWidth,
+        tileY * _tileHeight,
+        std::min((tileX + 1) * _tileWidth, phase.Width),
+        std::min((tileY + 1) * _tileHeight, phase.Height)
+    };
+}
+
+void TileScheduler::BuildTasks(std::vector<Task>& tasks) const
+{
+    for (int phaseId = 0; phaseId < (int)_phases.size(); phaseId++)
+    {
+        const Phase& phase = _phases[phaseId];
+
+        for (int tileY = 0; tileY < phase.TilesY; tileY++)
+        {
+            for (int tileX = 0; tileX < phase.TilesX; tileX++)
+            {
+                int taskId = phase.FirstTask + tileY * phase.TilesX + tileX;
+                Task& task = tasks[taskId];
+                task.PhaseId = phaseId;
+                task.Rect = GetTileRect(phase, tileX, tileY);
+
+                if (phaseId == 0) continue;
+
+                // previous phase tiles overlapping the input region (halo included), all of them without one
+                const Phase& previous = _phases[phaseId - 1];
+                TileRect region = phase.InputRegion ? phase.InputRegion(task.Rect) : TileRect{ 0, 0, previous.Width, previous.Height };
+                region.X0 = std::max(region.X0, 0);
+                region.Y0 = std::max(region.Y0, 0);
+                region.X1 = std::min(region.X1, previous.Width);
+                region.Y1 = std::min(region.Y1, previous.Height);
+                if (region.IsEmpty()) continue;
+
+                for (int inputY = region.Y0 / _tileHeight; inputY <= (region.Y1 - 1) / _tileHeight; inputY++)
+                {
+                    for (int inputX = region.X0 / _tileWidth; inputX <= (region.X1 - 1) / _tileWidth; inputX++)
+                    {
+                        tasks[previous.FirstTask + inputY * previous.TilesX + inputX].Successors.push_back(taskId);
+                        task.Dependencies++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void TileScheduler::RunTask(std::vector<Task>& tasks, int taskId, TaskGroup& group)
+{
+    Task& task = tasks[taskId];
+    _phases[task.PhaseId].Process(task.Rect);
+
+    for (int successor : task.Successors)
+    {
+        if (--tasks[successor].Dependencies == 0)
+        {
+            group.Run([this, &tasks, successor, &group] { RunTask(tasks, successor, group); });
+        }
+    }
+}
+
+void TileScheduler::Run(ThreadPool& pool)
+{
+    int taskCount = _phases.empty() ? 0 : _phases.back().FirstTask + _phases.back().TilesX * _phases.back().TilesY;
+    if (taskCount == 0) return;
+
+    std::vector<Task> tasks(taskCount);
+    BuildTasks(tasks);
+
+    // collected up front: once tasks run, dependency counters of later tiles start dropping to 0
+    std::vector<int> readyTasks;
+    for (int taskId = 0; taskId < taskCount; taskId++)
+    {
+        if (tasks[taskId].Dependencies == 0) readyTasks.push_back(taskId);
+    }
+
+    TaskGroup group(pool);
+    for (int taskId : readyTasks)
+    {
+        group.Run([this, &tasks, taskId, &group] { RunTask(tasks, taskId, group); });
+    }
+    group.Wait();
+}
+
+void TileScheduler::RunSequential()
+{
+    for (const Phase& phase : _phases)
+    {
+        for (int tileY = 0; tileY < phase.TilesY; tileY++)
+        {
+            for (int tileX = 0; tileX < phase.TilesX; tileX++)
+            {
+                phase.Process(GetTileRect(phase, tileX, tileY));
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// FIFO shared between threads: Push blocks while the queue is full, Pop blocks while it is empty and open
+template <typename T>
+class BoundedQueue
+{
+    public:
+        explicit BoundedQueue(size_t capacity) : _capacity(capacity > 0 ? capacity : 1) {}
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // false when the queue has been closed
+        bool Push(T item)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _notFull.wait(lock, [this] { return _closed || _items.size() < _capacity; });
+            if (_closed) return false;
+
+            _items.push_back(std::move(item));
+            _notEmpty.notify_one();
+            return true;
+        }
+
+        // false once the queue is closed and drained
+        bool Pop(T& item)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _notEmpty.wait(lock, [this] { return _closed || !_items.empty(); });
+            if (_items.empty()) return false;
+
+            item = std::move(_items.front());
+            _items.pop_front();
+            _notFull.notify_one();
+            return true;
+        }
+
+        // wakes every waiting thread, later Push calls fail and Pop returns what is left
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+            _notEmpty.notify_all();
+            _notFull.notify_all();
+        }
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _notEmpty;
+        std::condition_variable _notFull;
+        std::deque<T> _items;
+        size_t _capacity;
+        bool _closed = false;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Disjoint sets over [0, size) that several threads may Union and Find at the same time without locks.
+// Union links the larger root below the smaller one with a compare-and-swap and retries when another thread
+// got there first, so the root of a set is always its smallest element whatever the order of the unions.
+class ConcurrentUnionFind
+{
+    public:
+        // storage for size elements, MakeSets initializes them
+        void Resize(uint32_t size);
+        // every element of [begin, end) becomes its own set, ranges may be initialized by different threads
+        void MakeSets(uint32_t begin, uint32_t end);
+
+        uint32_t GetSize() const { return _size; }
+
+        uint32_t Find(uint32_t element);
+        void Union(uint32_t a, uint32_t b);
+
+        // Joins a singleton that no other thread can reach yet to the set of other (other < element),
+        // a plain store instead of the compare-and-swap loop of Union
+        void Attach(uint32_t element, uint32_t other) { _parent[element].store(Find(other), std::memory_order_relaxed); }
+
+        // parents are always smaller than their children: once the unions are done, walking the elements in
+        // ascending order reaches every parent before its children
+        uint32_t Parent(uint32_t element) const { return _parent[element].load(std::memory_order_relaxed); }
+
+
+    private:
+        uint32_t _size = 0;
+        uint32_t _capacity = 0;
+        std::unique_ptr<std::atomic<uint32_t>[]> _parent;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Whole file mapped into memory, read-only or read-write
+class MappedFile
+{
+    public:
+        MappedFile() = default;
+        ~MappedFile() { Close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool OpenRead(const std::string& filename);
+        // creates (or truncates) the file with `size` bytes and maps it for writing
+        bool Create(const std::string& filename, size_t size);
+        void Close();
+
+        bool IsOpen() const { return _open; }
+        const uint8_t* Data() const { return _data; }
+        // only valid for files opened with Create
+        uint8_t* MutableData() { return _data; }
+        size_t Size() const { return _size; }
+
+        // the file is about to be read front to back
+        void AdviseSequential();
+
+    private:
+        bool Map(bool writable);
+
+    private:
+        bool _open = false;
+        bool _writable = false;
+        uint8_t* _data = nullptr;
+        size_t _size = 0;
+
+#if defined(_WIN32)
+        void* _file = nullptr;
+        void* _mapping = nullptr;
+#else
+        int _fd = -1;
+#endif
+};
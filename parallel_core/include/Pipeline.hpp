@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Load -> process -> save over items [0, count) as three overlapping stages:
+// load runs on its own thread, process on the calling thread and save on a third one,
+// so loading item N + 1 and saving item N - 1 happen while item N is processed.
+// slotCount sets of buffers circulate between the stages and every stage gets the slot holding
+// the buffers of its item, at most slotCount items are in flight.
+// A stage returning false drops the item, the result is the number of items saved.
+using PipelineStage = std::function<bool(size_t item, int slot)>;
+
+size_t RunPipeline(size_t count, int slotCount, const PipelineStage& load, const PipelineStage& process, const PipelineStage& save);
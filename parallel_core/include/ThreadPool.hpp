@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent set of worker threads, each with its own task deque.
+// A worker runs its newest task first and steals the oldest task of another worker when it runs dry.
+// Threads waiting for tasks (TaskGroup::Wait, ParallelFor) run queued tasks meanwhile,
+// so parallel loops can be nested inside tasks.
+class ThreadPool
+{
+    public:
+        using Task = std::function<void()>;
+        using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+        // pinThreads binds worker i to the i-th CPU the process is allowed to run on
+        explicit ThreadPool(int threadCount, bool pinThreads = false);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Process wide pool per thread count, created on first use and kept alive until exit,
+        // so references handed out earlier stay valid when another count is asked for.
+        // PARALLEL_CORE_PIN=1 in the environment pins its workers.
+        static ThreadPool& Shared(int threadCount);
+
+        int GetThreadCount() const { return (int)_workers.size(); }
+
+        // called from a worker the task goes to that worker's deque, otherwise queues are filled round robin
+        void Submit(Task task);
+
+        // runs one queued task on the calling thread, false when every queue is empty
+        bool RunPendingTask();
+
+        // fn(chunkBegin, chunkEnd) over [begin, end) in chunks of `grain` items
+        // (0 picks about 4 chunks per worker), returns when every chunk is done
+        void ParallelFor(size_t begin, size_t end, const RangeFunction& fn, size_t grain = 0);
+
+        // map(chunkBegin, chunkEnd) -> T per chunk, partial results are combined in chunk order
+        // so the result does not depend on the thread count or on scheduling
+        // (grain 0 splits into ReduceChunks chunks whatever the worker count)
+        static constexpr size_t ReduceChunks = 64;
+        template <typename T, typename Map, typename Combine>
+        T ParallelReduce(size_t begin, size_t end, T identity, Map map, Combine combine, size_t grain = 0);
+
+    private:
+        struct TaskQueue {
+            std::mutex Mutex;
+            std::deque<Task> Tasks;
+        };
+
+        size_t GetGrain(size_t count, size_t grain) const;
+        void WorkerLoop(int index, int cpu);
+        bool TryPop(int index, Task& task);
+        bool TrySteal(int index, Task& task);
+        void OnTaskTaken();
+
+    private:
+        std::vector<std::unique_ptr<TaskQueue>> _queues;
+        std::vector<std::thread> _workers;
+        std::atomic<unsigned> _nextQueue{0};
+
+        // idle workers sleep until something is queued
+        std::mutex _sleepMutex;
+        std::condition_variable _wake;
+        int _queuedTasks = 0;
+        bool _stop = false;
+};
+
+// Tasks submitted through a group can be waited for together, tasks may add more tasks to their group
+class TaskGroup
+{
+    public:
+        explicit TaskGroup(ThreadPool& pool) : _pool(pool) {}
+        ~TaskGroup() { Wait(); }
+
+        void Run(ThreadPool::Task task);
+
+        // runs queued tasks of the pool until every task of the group is finished
+        void Wait();
+
+    private:
+        ThreadPool& _pool;
+        std::atomic<int> _pending{0};
+        std::mutex _doneMutex;
+        std::condition_variable _done;
+};
+
+template <typename T, typename Map, typename Combine>
+T ThreadPool::ParallelReduce(size_t begin, size_t end, T identity, Map map, Combine combine, size_t grain)
+{
+    if (begin >= end) return identity;
+
+    if (grain == 0) grain = std::max<size_t>(1, (end - begin + ReduceChunks - 1) / ReduceChunks);
+    size_t chunkCount = (end - begin + grain - 1) / grain;
+    std::vector<T> partials(chunkCount, identity);
+
+    ParallelFor(0, chunkCount, [&](size_t firstChunk, size_t lastChunk) {
+        for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+        {
+            size_t chunkBegin = begin + chunk * grain;
+            partials[chunk] = map(chunkBegin, std::min(chunkBegin + grain, end));
+        }
+    }, 1);
+
+    T result = identity;
+    for (T& partial : partials) result = combine(result, partial);
+    return result;
+}
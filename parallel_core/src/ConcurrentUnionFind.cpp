@@ -0,0 +1,48 @@
+#include "ConcurrentUnionFind.hpp"
+
+#include <utility>
+
+void ConcurrentUnionFind::Resize(uint32_t size)
+{
+    if (size > _capacity)
+    {
+        _parent.reset(new std::atomic<uint32_t>[size]);
+        _capacity = size;
+    }
+    _size = size;
+}
+
+void ConcurrentUnionFind::MakeSets(uint32_t begin, uint32_t end)
+{
+    for (uint32_t i = begin; i < end; i++) _parent[i].store(i, std::memory_order_relaxed);
+}
+
+uint32_t ConcurrentUnionFind::Find(uint32_t element)
+{
+    uint32_t parent = _parent[element].load(std::memory_order_relaxed);
+    while (parent != element)
+    {
+        // Path halving. element is not a root, so Union never swaps its parent and the only writers are other
+        // halvings: whichever store lands last still points at an ancestor, a plain store is enough.
+        uint32_t grandparent = _parent[parent].load(std::memory_order_relaxed);
+        if (grandparent != parent) _parent[element].store(grandparent, std::memory_order_relaxed);
+        element = parent;
+        parent = _parent[element].load(std::memory_order_relaxed);
+    }
+    return element;
+}
+
+void ConcurrentUnionFind::Union(uint32_t a, uint32_t b)
+{
+    while (true)
+    {
+        a = Find(a);
+        b = Find(b);
+        if (a == b) return;
+        if (a < b) std::swap(a, b);
+
+        // a is a root larger than b: it stays linkable only while nobody linked it elsewhere
+        uint32_t expected = a;
+        if (_parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) return;
+    }
+}
@@ -0,0 +1,156 @@
+#include "MappedFile.hpp"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+bool MappedFile::OpenRead(const std::string& filename)
+{
+    Close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    _file = file;
+    _size = (size_t)size.QuadPart;
+    return Map(false);
+}
+
+bool MappedFile::Create(const std::string& filename, size_t size)
+{
+    Close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    _file = file;
+    _size = size;
+    return Map(true);
+}
+
+bool MappedFile::Map(bool writable)
+{
+    _writable = writable;
+    _open = true;
+    if (_size == 0) return true;
+
+    LARGE_INTEGER size;
+    size.QuadPart = (LONGLONG)_size;
+    _mapping = CreateFileMappingA((HANDLE)_file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, size.HighPart, size.LowPart, nullptr);
+    if (_mapping)
+    {
+        _data = (uint8_t*)MapViewOfFile((HANDLE)_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, _size);
+    }
+
+    if (!_data)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data) UnmapViewOfFile(_data);
+    if (_mapping) CloseHandle((HANDLE)_mapping);
+    if (_file) CloseHandle((HANDLE)_file);
+
+    _data = nullptr;
+    _mapping = nullptr;
+    _file = nullptr;
+    _size = 0;
+    _open = false;
+    _writable = false;
+}
+
+void MappedFile::AdviseSequential()
+{
+}
+
+#else
+
+bool MappedFile::OpenRead(const std::string& filename)
+{
+    Close();
+
+    _fd = open(filename.c_str(), O_RDONLY);
+    if (_fd < 0) return false;
+
+    struct stat info;
+    if (fstat(_fd, &info) != 0)
+    {
+        Close();
+        return false;
+    }
+
+    _size = (size_t)info.st_size;
+    return Map(false);
+}
+
+bool MappedFile::Create(const std::string& filename, size_t size)
+{
+    Close();
+
+    _fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) return false;
+
+    if (ftruncate(_fd, (off_t)size) != 0)
+    {
+        Close();
+        return false;
+    }
+
+    _size = size;
+    return Map(true);
+}
+
+bool MappedFile::Map(bool writable)
+{
+    _writable = writable;
+    _open = true;
+    if (_size == 0) return true;
+
+    void* data = mmap(nullptr, _size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+
+    _data = (uint8_t*)data;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data) munmap(_data, _size);
+    if (_fd >= 0) close(_fd);
+
+    _data = nullptr;
+    _fd = -1;
+    _size = 0;
+    _open = false;
+    _writable = false;
+}
+
+void MappedFile::AdviseSequential()
+{
+    if (_data) madvise(_data, _size, MADV_SEQUENTIAL);
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "Pipeline.hpp"
+
+#include <thread>
+
+#include "BoundedQueue.hpp"
+
+namespace
+{
+    struct PipelineJob {
+        size_t Item = 0;
+        int Slot = 0;
+    };
+}
+
+size_t RunPipeline(size_t count, int slotCount, const PipelineStage& load, const PipelineStage& process, const PipelineStage& save)
+{
+    if (slotCount < 1) slotCount = 1;
+
+    // free slots go back to the loader, so a slow stage stalls the ones before it instead of piling up items
+    BoundedQueue<int> freeSlots(slotCount);
+    BoundedQueue<PipelineJob> loaded(slotCount);
+    BoundedQueue<PipelineJob> processed(slotCount);
+    for (int slot = 0; slot < slotCount; slot++) freeSlots.Push(slot);
+
+    std::thread loader([&] {
+        for (size_t item = 0; item < count; item++)
+        {
+            int slot;
+            if (!freeSlots.Pop(slot)) break;
+
+            if (load(item, slot)) loaded.Push({ item, slot });
+            else freeSlots.Push(slot);
+        }
+        loaded.Close();
+    });
+
+    size_t saved = 0;
+    std::thread saver([&] {
+        PipelineJob job;
+        while (processed.Pop(job))
+        {
+            if (save(job.Item, job.Slot)) saved++;
+            freeSlots.Push(job.Slot);
+        }
+    });
+
+    PipelineJob job;
+    while (loaded.Pop(job))
+    {
+        if (process(job.Item, job.Slot)) processed.Push(job);
+        else freeSlots.Push(job.Slot);
+    }
+    processed.Close();
+
+    saver.join();
+    freeSlots.Close();
+    loader.join();
+    return saved;
+}
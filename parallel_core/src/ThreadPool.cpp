@@ -0,0 +1,243 @@
+#include "ThreadPool.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// worker identity of the current thread, used to keep submitted tasks local
+static thread_local ThreadPool* t_pool = nullptr;
+static thread_local int t_workerIndex = -1;
+
+static std::vector<int> GetAllowedCpus()
+{
+    std::vector<int> cpus;
+#if defined(_WIN32)
+    DWORD_PTR processMask = 0, systemMask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    {
+        for (int cpu = 0; cpu < (int)(sizeof(DWORD_PTR) * 8); cpu++)
+        {
+            if (processMask & ((DWORD_PTR)1 << cpu)) cpus.push_back(cpu);
+        }
+    }
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    return cpus;
+}
+
+static void PinCurrentThread(int cpu)
+{
+    if (cpu < 0) return;
+#if defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+ThreadPool::ThreadPool(int threadCount, bool pinThreads)
+{
+    if (threadCount < 1) threadCount = 1;
+
+    std::vector<int> cpus;
+    if (pinThreads) cpus = GetAllowedCpus();
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        _queues.push_back(std::make_unique<TaskQueue>());
+    }
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        _workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i, cpu));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+
+    for (auto& worker : _workers)
+    {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::Shared(int threadCount)
+{
+    static std::mutex mutex;
+    // pools handed out stay alive until exit, callers may keep references to them
+    static std::map<int, std::unique_ptr<ThreadPool>> pools;
+
+    if (threadCount < 1) threadCount = 1;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<ThreadPool>& pool = pools[threadCount];
+    if (!pool)
+    {
+        const char* pin = std::getenv("PARALLEL_CORE_PIN");
+        pool = std::make_unique<ThreadPool>(threadCount, pin && std::strcmp(pin, "1") == 0);
+    }
+    return *pool;
+}
+
+void ThreadPool::Submit(Task task)
+{
+    int index = (t_pool == this) ? t_workerIndex : (int)(_nextQueue++ % _queues.size());
+
+    {
+        std::lock_guard<std::mutex> lock(_queues[index]->Mutex);
+        _queues[index]->Tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _queuedTasks++;
+    }
+    _wake.notify_one();
+}
+
+bool ThreadPool::TryPop(int index, Task& task)
+{
+    TaskQueue& queue = *_queues[index];
+    std::lock_guard<std::mutex> lock(queue.Mutex);
+    if (queue.Tasks.empty()) return false;
+
+    task = std::move(queue.Tasks.back());
+    queue.Tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::TrySteal(int index, Task& task)
+{
+    int count = (int)_queues.size();
+    for (int offset = 1; offset <= count; offset++)
+    {
+        TaskQueue& victim = *_queues[(index + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.Mutex);
+        if (victim.Tasks.empty()) continue;
+
+        task = std::move(victim.Tasks.front());
+        victim.Tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::OnTaskTaken()
+{
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _queuedTasks--;
+}
+
+bool ThreadPool::RunPendingTask()
+{
+    Task task;
+    bool found = (t_pool == this) ? (TryPop(t_workerIndex, task) || TrySteal(t_workerIndex, task))
+                                  : TrySteal(0, task);
+    if (!found) return false;
+
+    OnTaskTaken();
+    task();
+    return true;
+}
+
+void ThreadPool::WorkerLoop(int index, int cpu)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    PinCurrentThread(cpu);
+
+    while (true)
+    {
+        Task task;
+        if (TryPop(index, task) || TrySteal(index, task))
+        {
+            OnTaskTaken();
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this] { return _stop || _queuedTasks > 0; });
+        if (_stop && _queuedTasks == 0) return;
+    }
+}
+
+size_t ThreadPool::GetGrain(size_t count, size_t grain) const
+{
+    if (grain > 0) return grain;
+
+    size_t chunks = (size_t)GetThreadCount() * 4;
+    return std::max<size_t>(1, (count + chunks - 1) / chunks);
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, const RangeFunction& fn, size_t grain)
+{
+    if (begin >= end) return;
+
+    grain = GetGrain(end - begin, grain);
+    if (end - begin <= grain)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    TaskGroup group(*this);
+    for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grain)
+    {
+        size_t chunkEnd = std::min(chunkBegin + grain, end);
+        group.Run([&fn, chunkBegin, chunkEnd] { fn(chunkBegin, chunkEnd); });
+    }
+    group.Wait();
+}
+
+void TaskGroup::Run(ThreadPool::Task task)
+{
+    _pending++;
+    _pool.Submit([this, task = std::move(task)] {
+        task();
+        // decremented under the lock: Wait() takes it before returning, so the group outlives this
+        std::lock_guard<std::mutex> lock(_doneMutex);
+        if (--_pending == 0) _done.notify_all();
+    });
+}
+
+void TaskGroup::Wait()
+{
+    while (_pending > 0)
+    {
+        if (_pool.RunPendingTask()) continue;
+
+        // the remaining tasks are running on other threads
+        std::unique_lock<std::mutex> lock(_doneMutex);
+        _done.wait_for(lock, std::chrono::milliseconds(1), [this] { return _pending == 0; });
+    }
+
+    std::lock_guard<std::mutex> lock(_doneMutex);
+}